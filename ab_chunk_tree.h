@@ -0,0 +1,1396 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_CHUNK_TREE_H__
+#define __RULER_AB_CHUNK_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include "ab_tree.h"
+
+// The default number of elements per chunk, about 512 bytes of payload.
+static constexpr size_t ab_chunk_tree_default_size(size_t n)
+{
+	return n > 128 ? 4 : (n < 4 ? 128 : 512 / n);
+}
+
+
+// Class template ab_chunk_tree_node
+template <class T, size_t ChunkSize>
+struct ab_chunk_tree_node
+{
+	using node_type            = ab_chunk_tree_node<T, ChunkSize>;
+	using node_pointer         = node_type*;
+	using const_node_pointer   = const node_type*;
+	using node_reference       = node_type&;
+	using const_node_reference = const node_type&;
+
+	node_pointer               parent;
+	node_pointer               left;
+	node_pointer               right;
+	size_t                     size;   // the number of elements in the subtree
+	size_t                     weight; // the number of nodes in the subtree
+	size_t                     count;  // the number of elements in this node
+	alignas(T) unsigned char   data[ChunkSize * sizeof(T)];
+
+	inline T* elements(void) noexcept
+	{
+		return reinterpret_cast<T*>(data);
+	}
+	inline const T* elements(void) const noexcept
+	{
+		return reinterpret_cast<const T*>(data);
+	}
+};
+
+
+// Class template ab_chunk_tree_iterator
+template <class Tree, bool IsConst>
+class ab_chunk_tree_iterator
+{
+public:
+	// types:
+
+	using value_type        = typename ab_tree_type_traits<Tree, IsConst>::value_type;
+	using pointer           = typename ab_tree_type_traits<Tree, IsConst>::pointer;
+	using reference         = typename ab_tree_type_traits<Tree, IsConst>::reference;
+	using size_type         = typename ab_tree_type_traits<Tree, IsConst>::size_type;
+	using difference_type   = typename ab_tree_type_traits<Tree, IsConst>::difference_type;
+	using node_type         = typename ab_tree_type_traits<Tree, IsConst>::node_type;
+	using node_pointer      = typename ab_tree_type_traits<Tree, IsConst>::node_pointer;
+
+	using iterator_type     = ab_chunk_tree_iterator<Tree, IsConst>;
+	using iterator_category = std::bidirectional_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_chunk_tree_iterator(void) noexcept
+		: node(nullptr)
+		, offset(0)
+	{}
+	explicit ab_chunk_tree_iterator(const node_pointer p, size_type off = 0) noexcept
+		: node(p)
+		, offset(off)
+	{}
+	ab_chunk_tree_iterator(const ab_chunk_tree_iterator<Tree, IsConst>& other) noexcept
+		: node(other.get_pointer())
+		, offset(other.get_offset())
+	{}
+
+	inline ab_chunk_tree_iterator<Tree, IsConst>& operator=(const ab_chunk_tree_iterator<Tree, IsConst>& other) noexcept
+	{
+		if (this != &other)
+		{
+			node = other.get_pointer();
+			offset = other.get_offset();
+		}
+		return *this;
+	}
+
+	inline operator ab_chunk_tree_iterator<Tree, true>(void) const noexcept
+	{
+		return ab_chunk_tree_iterator<Tree, true>(node, offset);
+	}
+
+	// ab_chunk_tree_iterator operations:
+
+	inline node_pointer get_pointer(void) noexcept
+	{
+		return node;
+	}
+	inline const node_pointer get_pointer(void) const noexcept
+	{
+		return node;
+	}
+
+	inline size_type get_offset(void) const noexcept
+	{
+		return offset;
+	}
+
+	inline reference operator*(void) const noexcept
+	{
+		return node->elements()[offset];
+	}
+
+	inline pointer operator->(void) const noexcept
+	{
+		return &(operator*());
+	}
+
+	// increment / decrement
+
+	ab_chunk_tree_iterator<Tree, IsConst>& operator++(void) noexcept
+	{
+		if (++offset < node->count)
+			return *this;
+		offset = 0;
+		if (node->right)
+		{
+			node = node->right;
+			while (node->left)
+				node = node->left;
+		}
+		else
+		{
+			node_pointer p = node->parent;
+			while (node == p->right)
+			{
+				node = p;
+				p = p->parent;
+			}
+			if (node->right != p)
+				node = p;
+		}
+		return *this;
+	}
+
+	ab_chunk_tree_iterator<Tree, IsConst>& operator--(void) noexcept
+	{
+		if (offset > 0)
+		{
+			--offset;
+			return *this;
+		}
+		// the header is the only node without weight
+		if (node->weight == 0)
+			node = node->right;
+		else if (node->left)
+		{
+			node_pointer p = node->left;
+			while (p->right)
+				p = p->right;
+			node = p;
+		}
+		else
+		{
+			node_pointer p = node->parent;
+			while (node == p->left)
+			{
+				node = p;
+				p = p->parent;
+			}
+			node = p;
+		}
+		offset = node->count - 1;
+		return *this;
+	}
+
+	inline ab_chunk_tree_iterator<Tree, IsConst> operator++(int) noexcept
+	{
+		iterator_type itr(*this);
+		this->operator++();
+		return itr;
+	}
+
+	inline ab_chunk_tree_iterator<Tree, IsConst> operator--(int) noexcept
+	{
+		iterator_type itr(*this);
+		this->operator--();
+		return itr;
+	}
+
+	// relational operators:
+
+	template <bool is_const>
+	inline bool operator==(const ab_chunk_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return node == rhs.get_pointer() && offset == rhs.get_offset();
+	}
+
+	template <bool is_const>
+	inline bool operator!=(const ab_chunk_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return node != rhs.get_pointer() || offset != rhs.get_offset();
+	}
+
+private:
+	node_pointer node;
+	size_type    offset;
+};
+
+
+// Class template ab_chunk_tree_node_allocator
+template <class T, class Allocator, size_t ChunkSize>
+class ab_chunk_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_chunk_tree_node<T, ChunkSize>::node_type;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_chunk_tree_node_allocator(void)
+		: allocator()
+	{}
+	explicit ab_chunk_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+	{}
+	explicit ab_chunk_tree_node_allocator(Allocator&& alloc)
+		: allocator(std::forward<Allocator>(alloc))
+	{}
+
+	~ab_chunk_tree_node_allocator(void)
+	{}
+
+	// ab_chunk_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) noexcept
+	{
+		return allocator;
+	}
+	inline const allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		return node_traits_type::max_size(node_alloc) * ChunkSize;
+	}
+
+protected:
+
+	// creates a node without elements
+	inline node_pointer create_node(void)
+	{
+		node_pointer p = node_traits_type::allocate(node_alloc, 1);
+		p->parent = nullptr;
+		p->left = nullptr;
+		p->right = nullptr;
+		p->size = 0;
+		p->weight = 1;
+		p->count = 0;
+		return p;
+	}
+
+	// destroys the elements of a node and releases it
+	inline void destroy_node(const node_pointer p)
+	{
+		T* first = p->elements();
+		for (size_t i = 0; i < p->count; ++i)
+			traits_type::destroy(allocator, first + i);
+		node_traits_type::deallocate(node_alloc, p, 1);
+	}
+
+	template <class ...Args>
+	inline void construct_element(T* p, Args&&... args)
+	{
+		traits_type::construct(allocator, p, std::forward<Args>(args)...);
+	}
+
+	inline void destroy_element(T* p)
+	{
+		traits_type::destroy(allocator, p);
+	}
+
+	// moves n elements from src to dst, the ranges may overlap
+	inline void relocate_elements(T* dst, T* src, size_t n)
+	{
+		if (n == 0 || dst == src)
+			return;
+		if (std::is_trivially_copyable<T>::value)
+			std::memmove(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+		else if (dst < src)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				traits_type::construct(allocator, dst + i, std::move(src[i]));
+				traits_type::destroy(allocator, src + i);
+			}
+		}
+		else
+		{
+			for (size_t i = n; i > 0; --i)
+			{
+				traits_type::construct(allocator, dst + i - 1, std::move(src[i - 1]));
+				traits_type::destroy(allocator, src + i - 1);
+			}
+		}
+	}
+
+	inline void swap_allocator(ab_chunk_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_chunk_tree
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T), size_t ChunkSize = ab_chunk_tree_default_size(sizeof(T))>
+class ab_chunk_tree : public ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>
+{
+	static_assert(ChunkSize >= 4, "The chunk size of AB-Tree must be at least 4.");
+
+public:
+	// types:
+
+	using tree_type                        = ab_chunk_tree<T, Allocator, ChunkSize>;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_chunk_tree_node<T, ChunkSize>::node_type;
+	using node_pointer                     = node_type*;
+	using const_node_pointer               = const node_type*;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_chunk_tree_iterator<tree_type, false>;
+	using const_iterator                   = ab_chunk_tree_iterator<tree_type, true>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+
+	static constexpr size_type chunk_size  = ChunkSize;
+
+	// construct/copy/destroy:
+
+	explicit ab_chunk_tree(const Allocator& alloc = Allocator())
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(alloc)
+		, header(nullptr)
+	{
+		create_header();
+	}
+	ab_chunk_tree(const tree_type& other)
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(other.get_allocator())
+		, header(nullptr)
+	{
+		create_header();
+		if (other.header->parent)
+			copy_node(other.header->parent);
+	}
+	ab_chunk_tree(const tree_type& other, const Allocator& alloc)
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(alloc)
+		, header(nullptr)
+	{
+		create_header();
+		if (other.header->parent)
+			copy_node(other.header->parent);
+	}
+	ab_chunk_tree(tree_type&& other) noexcept
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(other.get_allocator())
+		, header(nullptr)
+	{
+		create_header();
+		swap(other);
+	}
+	ab_chunk_tree(tree_type&& other, const Allocator& alloc) noexcept
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(alloc)
+		, header(nullptr)
+	{
+		create_header();
+		swap(other);
+	}
+	ab_chunk_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+		: ab_chunk_tree_node_allocator<T, Allocator, ChunkSize>(alloc)
+		, header(nullptr)
+	{
+		create_header();
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_chunk_tree(void)
+	{
+		clear();
+		destroy_header();
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			if (other.header->parent)
+				copy_node(other.header->parent);
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		insert(cend(), n, value);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		insert(cend(), first, last);
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	// iterators:
+
+	inline iterator begin(void) noexcept
+	{
+		return iterator(header->left);
+	}
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(header->left);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(header->left);
+	}
+	inline iterator end(void) noexcept
+	{
+		return iterator(header);
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(header);
+	}
+	inline const_iterator cend(void) const noexcept
+	{
+		return const_iterator(header);
+	}
+
+	inline reverse_iterator rbegin(void) noexcept
+	{
+		return reverse_iterator(end());
+	}
+	inline const_reverse_iterator rbegin(void) const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+	inline const_reverse_iterator crbegin(void) const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+	inline reverse_iterator rend(void) noexcept
+	{
+		return reverse_iterator(begin());
+	}
+	inline const_reverse_iterator rend(void) const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+	inline const_reverse_iterator crend(void) const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	// capacity:
+
+	inline bool empty(void) const noexcept
+	{
+		return !header->parent;
+	}
+
+	inline size_type size(void) const noexcept
+	{
+		return header->parent ? header->parent->size : 0;
+	}
+
+	// element access:
+
+	inline reference operator[](size_type idx) noexcept
+	{
+		return *select(idx);
+	}
+	inline const_reference operator[](size_type idx) const noexcept
+	{
+		return *select(idx);
+	}
+
+	inline reference at(size_type idx)
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return *select(idx);
+	}
+	inline const_reference at(size_type idx) const
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return *select(idx);
+	}
+
+	inline reference front(void)
+	{
+		return *begin();
+	}
+	inline const_reference front(void) const
+	{
+		return *begin();
+	}
+
+	inline reference back(void)
+	{
+		return *rbegin();
+	}
+	inline const_reference back(void) const
+	{
+		return *rbegin();
+	}
+
+	// modifiers:
+
+	template <class... Args>
+	inline void emplace_front(Args&&... args)
+	{
+		size_type off = 0;
+		insert_element(header->left, off, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline void emplace_back(Args&&... args)
+	{
+		size_type off = 0;
+		insert_element(header, off, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline iterator emplace(const_iterator pos, Args&&... args)
+	{
+		size_type off = pos.get_offset();
+		node_pointer t = insert_element(pos.get_pointer(), off, std::forward<Args>(args)...);
+		return iterator(t, off);
+	}
+	template <class... Args>
+	inline iterator emplace(size_type idx, Args&&... args)
+	{
+		return emplace(select(idx), std::forward<Args>(args)...);
+	}
+
+	inline void push_front(const_reference value)
+	{
+		emplace_front(value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		emplace_front(std::forward<value_type>(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		emplace_back(value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		emplace_back(std::forward<value_type>(value));
+	}
+
+	inline void pop_front(void)
+	{
+		if (header->parent)
+			erase_element(header->left, 0);
+	}
+
+	inline void pop_back(void)
+	{
+		if (header->parent)
+			erase_element(header->right, header->right->count - 1);
+	}
+
+	inline iterator insert(const_iterator pos, const_reference value)
+	{
+		return emplace(pos, value);
+	}
+	inline iterator insert(const_iterator pos, value_type&& value)
+	{
+		return emplace(pos, std::forward<value_type>(value));
+	}
+	inline iterator insert(const_iterator pos, size_type n, const_reference value)
+	{
+		// copies the value first, it may refer to an element to be moved
+		value_type copy(value);
+		size_type idx = index_node(pos.get_pointer(), pos.get_offset());
+		iterator itr(pos.get_pointer(), pos.get_offset());
+		for (size_type i = 0; i < n; ++i)
+			++(itr = emplace(itr, copy));
+		return select(idx);
+	}
+	template <class InputIt>
+	inline iterator insert(const_iterator pos, InputIt first, InputIt last)
+	{
+		size_type idx = index_node(pos.get_pointer(), pos.get_offset());
+		iterator itr(pos.get_pointer(), pos.get_offset());
+		for (; first != last; ++first)
+			++(itr = emplace(itr, *first));
+		return select(idx);
+	}
+	inline iterator insert(const_iterator pos, std::initializer_list<value_type> ilist)
+	{
+		return insert(pos, ilist.begin(), ilist.end());
+	}
+	inline iterator insert(size_type idx, const_reference value)
+	{
+		return insert(select(idx), value);
+	}
+	inline iterator insert(size_type idx, value_type&& value)
+	{
+		return insert(select(idx), std::forward<value_type>(value));
+	}
+	inline iterator insert(size_type idx, size_type n, const_reference value)
+	{
+		return insert(select(idx), n, value);
+	}
+	template <class InputIt>
+	inline iterator insert(size_type idx, InputIt first, InputIt last)
+	{
+		return insert(select(idx), first, last);
+	}
+	inline iterator insert(size_type idx, std::initializer_list<value_type> ilist)
+	{
+		return insert(idx, ilist.begin(), ilist.end());
+	}
+
+	inline iterator erase(const_iterator pos)
+	{
+		if (pos == cend())
+			return end();
+		size_type idx = index_node(pos.get_pointer(), pos.get_offset());
+		erase_element(pos.get_pointer(), pos.get_offset());
+		return select(idx);
+	}
+	inline iterator erase(const_iterator first, const_iterator last)
+	{
+		if (first == cbegin() && last == cend())
+		{
+			clear();
+			return end();
+		}
+		size_type idx = index_node(first.get_pointer(), first.get_offset());
+		erase(idx, index_node(last.get_pointer(), last.get_offset()) - idx);
+		return select(idx);
+	}
+	inline void erase(size_type idx)
+	{
+		size_type off;
+		node_pointer t = select_node(idx, off);
+		if (t != header)
+			erase_element(t, off);
+	}
+	inline void erase(size_type idx, size_type n)
+	{
+		size_type off;
+		node_pointer t;
+		while (n > 0 && (t = select_node(idx, off)) != header)
+			n -= erase_elements(t, off, n);
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(header, rhs.header);
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		if (header->parent)
+		{
+			erase_root();
+			header->parent = nullptr;
+			header->left = header;
+			header->right = header;
+		}
+	}
+
+	// operations:
+
+	inline iterator select(size_type idx) noexcept
+	{
+		size_type off;
+		node_pointer t = select_node(idx, off);
+		return iterator(t, off);
+	}
+	inline const_iterator select(size_type idx) const noexcept
+	{
+		size_type off;
+		node_pointer t = select_node(idx, off);
+		return const_iterator(t, off);
+	}
+
+private:
+
+	inline size_type size_of(const node_pointer t) const noexcept
+	{
+		return t ? t->size : 0;
+	}
+
+	inline size_type weight_of(const node_pointer t) const noexcept
+	{
+		return t ? t->weight : 0;
+	}
+
+	inline node_pointer leftmost(node_pointer t) const noexcept
+	{
+		while (t->left)
+			t = t->left;
+		return t;
+	}
+
+	inline node_pointer rightmost(node_pointer t) const noexcept
+	{
+		while (t->right)
+			t = t->right;
+		return t;
+	}
+
+	inline node_pointer predecessor(node_pointer t) const noexcept
+	{
+		if (t->left)
+			return rightmost(t->left);
+		node_pointer p = t->parent;
+		while (t == p->left)
+		{
+			t = p;
+			p = p->parent;
+		}
+		return p;
+	}
+
+	inline node_pointer successor(node_pointer t) const noexcept
+	{
+		if (t->right)
+			return leftmost(t->right);
+		node_pointer p = t->parent;
+		while (p != header && t == p->right)
+		{
+			t = p;
+			p = p->parent;
+		}
+		return p;
+	}
+
+	inline void increase_size(node_pointer t, size_type n) const noexcept
+	{
+		for (; t != header; t = t->parent)
+			t->size += n;
+	}
+
+	inline void decrease_size(node_pointer t, size_type n) const noexcept
+	{
+		for (; t != header; t = t->parent)
+			t->size -= n;
+	}
+
+	inline void create_header(void)
+	{
+		if (!header)
+		{
+			header = this->create_node();
+			header->parent = nullptr;
+			header->left = header;
+			header->right = header;
+			header->weight = 0;
+		}
+	}
+
+	inline void destroy_header(void)
+	{
+		if (header)
+		{
+			this->destroy_node(header);
+			header = nullptr;
+		}
+	}
+
+	node_pointer select_node(size_type k, size_type& off) const noexcept
+	{
+		node_pointer t = header->parent;
+		while (t)
+		{
+			size_type left_size = size_of(t->left);
+			if (k < left_size)
+				t = t->left;
+			else if (k - left_size < t->count)
+			{
+				off = k - left_size;
+				return t;
+			}
+			else
+			{
+				k -= left_size + t->count;
+				t = t->right;
+			}
+		}
+		off = 0;
+		return header;
+	}
+
+	size_type index_node(node_pointer t, size_type off) const noexcept
+	{
+		if (t == header)
+			return size();
+		size_type k = size_of(t->left) + off;
+		for (node_pointer p = t->parent; p != header; t = p, p = p->parent)
+			if (t == p->right)
+				k += size_of(p->left) + p->count;
+		return k;
+	}
+
+	node_pointer clone_node(const node_pointer src, node_pointer parent)
+	{
+		node_pointer n = this->create_node();
+		const T* first = src->elements();
+		for (; n->count < src->count; ++n->count)
+			this->construct_element(n->elements() + n->count, first[n->count]);
+		n->parent = parent;
+		n->size = src->size;
+		n->weight = src->weight;
+		return n;
+	}
+
+	void copy_node(const node_pointer t)
+	{
+		bool flag = true;
+		node_pointer src = t;
+		node_pointer dst = clone_node(t, header);
+		header->parent = dst;
+		do
+		{
+			if (flag && src->left)
+			{
+				// copies the left child node
+				src = src->left;
+				dst->left = clone_node(src, dst);
+				dst = dst->left;
+			}
+			else if (flag && src->right)
+			{
+				// copies the right child node
+				src = src->right;
+				dst->right = clone_node(src, dst);
+				dst = dst->right;
+			}
+			else if (src->parent->right && src != src->parent->right)
+			{
+				// copies the sibling node
+				src = src->parent->right;
+				dst->parent->right = clone_node(src, dst->parent);
+				dst = dst->parent->right;
+				flag = true;
+			}
+			else
+			{
+				// return to parent node
+				src = src->parent;
+				dst = dst->parent;
+				flag = false;
+			}
+		} while (src != t);
+		header->left = leftmost(header->parent);
+		header->right = rightmost(header->parent);
+	}
+
+	// links the node n as the in-order successor of node t
+	void link_after(node_pointer t, node_pointer n)
+	{
+		if (t->right)
+		{
+			t = leftmost(t->right);
+			t->left = n;
+		}
+		else
+		{
+			t->right = n;
+			if (t == header->right)
+				header->right = n;
+		}
+		link_rebalance(t, n);
+	}
+
+	// links the node n as the in-order predecessor of node t
+	void link_before(node_pointer t, node_pointer n)
+	{
+		if (t->left)
+		{
+			t = rightmost(t->left);
+			t->right = n;
+		}
+		else
+		{
+			t->left = n;
+			if (t == header->left)
+				header->left = n;
+		}
+		link_rebalance(t, n);
+	}
+
+	void link_rebalance(node_pointer t, node_pointer n)
+	{
+		n->parent = t;
+		n->size = n->count;
+		n->weight = 1;
+		// increases the size and weight of nodes
+		for (node_pointer p = t; p != header; p = p->parent)
+		{
+			p->size += n->count;
+			++p->weight;
+		}
+		// rebalance after insertion
+		for (node_pointer p = n; p->parent != header; )
+			p = insert_rebalance(p->parent, p == p->parent->right);
+	}
+
+	// inserts an element before the off-th element of node t
+	template <class ...Args>
+	node_pointer insert_element(node_pointer t, size_type& off, Args&&... args)
+	{
+		// if the tree is empty
+		if (!header->parent)
+		{
+			node_pointer n = this->create_node();
+			this->construct_element(n->elements(), std::forward<Args>(args)...);
+			n->count = 1;
+			n->size = 1;
+			n->parent = header;
+			header->parent = n;
+			header->left = n;
+			header->right = n;
+			off = 0;
+			return n;
+		}
+		if (t == header)
+		{
+			t = header->right;
+			off = t->count;
+		}
+		else if (off == 0 && t != header->left)
+		{
+			// appends to the predecessor if it has space
+			node_pointer p = predecessor(t);
+			if (p->count < ChunkSize)
+			{
+				t = p;
+				off = p->count;
+			}
+		}
+		// the element is appended to a node with space
+		if (off == t->count && off < ChunkSize)
+		{
+			this->construct_element(t->elements() + off, std::forward<Args>(args)...);
+			++t->count;
+			increase_size(t, 1);
+			return t;
+		}
+		// the node is full and the element is at one end of it
+		if (t->count == ChunkSize && (off == 0 || off == ChunkSize))
+		{
+			node_pointer n = this->create_node();
+			this->construct_element(n->elements(), std::forward<Args>(args)...);
+			n->count = 1;
+			if (off == 0)
+				link_before(t, n);
+			else
+				link_after(t, n);
+			off = 0;
+			return n;
+		}
+		// constructs the element first, it may refer to an element of the node
+		value_type value(std::forward<Args>(args)...);
+		if (t->count == ChunkSize)
+		{
+			// splits the node into two halves
+			size_type half = ChunkSize / 2;
+			node_pointer n = this->create_node();
+			this->relocate_elements(n->elements(), t->elements() + half, ChunkSize - half);
+			n->count = ChunkSize - half;
+			t->count = half;
+			decrease_size(t, n->count);
+			link_after(t, n);
+			if (off > half)
+			{
+				t = n;
+				off -= half;
+			}
+		}
+		// inserts the element into the node
+		this->relocate_elements(t->elements() + off + 1, t->elements() + off, t->count - off);
+		this->construct_element(t->elements() + off, std::move(value));
+		++t->count;
+		increase_size(t, 1);
+		return t;
+	}
+
+	// erases the off-th element of node t
+	void erase_element(node_pointer t, size_type off)
+	{
+		erase_elements(t, off, 1);
+	}
+
+	// erases at most n elements starting from the off-th element of node t
+	size_type erase_elements(node_pointer t, size_type off, size_type n)
+	{
+		T* first = t->elements();
+		if (n > t->count - off)
+			n = t->count - off;
+		for (size_type i = 0; i < n; ++i)
+			this->destroy_element(first + off + i);
+		this->relocate_elements(first + off, first + off + n, t->count - off - n);
+		t->count -= n;
+		decrease_size(t, n);
+		if (t->count == 0)
+			erase_node(t);
+		else if (t->count < ChunkSize / 4)
+			merge_node(t);
+		return n;
+	}
+
+	// merges a sparse node t into one of its neighbours
+	void merge_node(node_pointer t)
+	{
+		node_pointer p;
+		size_type n = t->count;
+		if (t != header->right && (p = successor(t))->count + n <= ChunkSize)
+		{
+			this->relocate_elements(p->elements() + n, p->elements(), p->count);
+			this->relocate_elements(p->elements(), t->elements(), n);
+		}
+		else if (t != header->left && (p = predecessor(t))->count + n <= ChunkSize)
+			this->relocate_elements(p->elements() + p->count, t->elements(), n);
+		else
+			return;
+		p->count += n;
+		t->count = 0;
+		increase_size(p, n);
+		decrease_size(t, n);
+		erase_node(t);
+	}
+
+	// erases the empty node t
+	void erase_node(node_pointer t)
+	{
+		bool flag;
+		node_pointer x;
+		node_pointer parent;
+		// case 1. has one child node at most
+		if (!t->left || !t->right)
+		{
+			x = t->left ? t->left : t->right;
+			parent = t->parent;
+			// the rebalance flag
+			flag = (t == parent->right);
+			// removes t node
+			if (x)
+				x->parent = parent;
+			if (t == header->parent)
+				header->parent = x;
+			else if (t == parent->left)
+				parent->left = x;
+			else
+				parent->right = x;
+			if (t == header->left)
+				header->left = x ? leftmost(x) : parent;
+			if (t == header->right)
+				header->right = x ? rightmost(x) : parent;
+			// reduces the weight of nodes
+			for (node_pointer p = parent; p != header; p = p->parent)
+				--p->weight;
+		}
+		// case 2. has two child nodes
+		else
+		{
+			bool successor = t->left->weight < t->right->weight;
+			x = successor ? leftmost(t->right) : rightmost(t->left);
+			// the rebalance flag
+			flag = (x == x->parent->right);
+			// reduces the size and weight of nodes
+			bool below = true;
+			for (node_pointer p = x->parent; p != header; p = p->parent)
+			{
+				if (p == t)
+					below = false;
+				if (below)
+					p->size -= x->count;
+				--p->weight;
+			}
+			// replaces t node with x node and removes t node
+			if (successor)
+			{
+				t->left->parent = x;
+				x->left = t->left;
+				if (x != t->right)
+				{
+					x->parent->left = x->right;
+					if (x->right)
+						x->right->parent = x->parent;
+					t->right->parent = x;
+					x->right = t->right;
+					parent = x->parent;
+				}
+				else
+					parent = x;
+			}
+			else
+			{
+				t->right->parent = x;
+				x->right = t->right;
+				if (x != t->left)
+				{
+					x->parent->right = x->left;
+					if (x->left)
+						x->left->parent = x->parent;
+					t->left->parent = x;
+					x->left = t->left;
+					parent = x->parent;
+				}
+				else
+					parent = x;
+			}
+			if (t == header->parent)
+				header->parent = x;
+			else if (t == t->parent->left)
+				t->parent->left = x;
+			else
+				t->parent->right = x;
+			x->parent = t->parent;
+			x->size = t->size;
+			x->weight = t->weight;
+		}
+		// rebalance after deletion
+		if (parent != header)
+		{
+			node_pointer p = erase_rebalance(parent, flag);
+			while (p->parent != header)
+				p = erase_rebalance(p->parent, p == p->parent->right);
+		}
+		// destroy node
+		this->destroy_node(t);
+	}
+
+	void erase_root(void)
+	{
+		node_pointer next;
+		node_pointer cur = header->parent;
+		do
+		{
+			while (cur->left)
+				cur = cur->left;
+			if (cur->right)
+				cur = cur->right;
+			else
+			{
+				next = cur->parent;
+				if (cur == next->left)
+					next->left = nullptr;
+				else
+					next->right = nullptr;
+				this->destroy_node(cur);
+				cur = next;
+			}
+		} while (cur != header);
+	}
+
+	node_pointer left_rotate(node_pointer t) const noexcept
+	{
+		node_pointer r = t->right;
+		t->right = r->left;
+		if (r->left)
+			r->left->parent = t;
+		r->parent = t->parent;
+		if (t == header->parent)
+			header->parent = r;
+		else if (t == t->parent->left)
+			t->parent->left = r;
+		else
+			t->parent->right = r;
+		r->left = t;
+		r->size = t->size;
+		r->weight = t->weight;
+		t->parent = r;
+		t->size = size_of(t->left) + size_of(t->right) + t->count;
+		t->weight = weight_of(t->left) + weight_of(t->right) + 1;
+		return r;
+	}
+
+	node_pointer right_rotate(node_pointer t) const noexcept
+	{
+		node_pointer l = t->left;
+		t->left = l->right;
+		if (l->right)
+			l->right->parent = t;
+		l->parent = t->parent;
+		if (t == header->parent)
+			header->parent = l;
+		else if (t == t->parent->right)
+			t->parent->right = l;
+		else
+			t->parent->left = l;
+		l->right = t;
+		l->size = t->size;
+		l->weight = t->weight;
+		t->parent = l;
+		t->size = size_of(t->left) + size_of(t->right) + t->count;
+		t->weight = weight_of(t->left) + weight_of(t->right) + 1;
+		return l;
+	}
+
+	// the balance is kept on the number of nodes, not on the number of elements
+	node_pointer insert_rebalance(node_pointer t, bool flag)
+	{
+		if (flag)
+		{
+			if (t->right)
+			{
+				size_type left_weight = weight_of(t->left);
+				// case 1: weight(T.left) < weight(T.right.left)
+				if (t->right->left && left_weight < t->right->left->weight)
+				{
+					t->right = right_rotate(t->right);
+					t = left_rotate(t);
+					t->left = insert_rebalance(t->left, false);
+					t->right = insert_rebalance(t->right, true);
+					t = insert_rebalance(t, true);
+				}
+				// case 2. weight(T.left) < weight(T.right.right)
+				else if (t->right->right && left_weight < t->right->right->weight)
+				{
+					t = left_rotate(t);
+					t->left = insert_rebalance(t->left, false);
+					t = insert_rebalance(t, true);
+				}
+			}
+		}
+		else
+		{
+			if (t->left)
+			{
+				size_type right_weight = weight_of(t->right);
+				// case 3. weight(T.right) < weight(T.left.right)
+				if (t->left->right && right_weight < t->left->right->weight)
+				{
+					t->left = left_rotate(t->left);
+					t = right_rotate(t);
+					t->left = insert_rebalance(t->left, false);
+					t->right = insert_rebalance(t->right, true);
+					t = insert_rebalance(t, false);
+				}
+				// case 4. weight(T.right) < weight(T.left.left)
+				else if (t->left->left && right_weight < t->left->left->weight)
+				{
+					t = right_rotate(t);
+					t->right = insert_rebalance(t->right, true);
+					t = insert_rebalance(t, false);
+				}
+			}
+		}
+		return t;
+	}
+
+	node_pointer erase_rebalance(node_pointer t, bool flag)
+	{
+		if (!flag)
+		{
+			if (t->right)
+			{
+				size_type left_weight = weight_of(t->left);
+				// case 1: weight(T.left) < weight(T.right.left)
+				if (t->right->left && left_weight < t->right->left->weight)
+				{
+					t->right = right_rotate(t->right);
+					t = left_rotate(t);
+					t->left = erase_rebalance(t->left, true);
+					t->right = erase_rebalance(t->right, false);
+					t = erase_rebalance(t, false);
+				}
+				// case 2. weight(T.left) < weight(T.right.right)
+				else if (t->right->right && left_weight < t->right->right->weight)
+				{
+					t = left_rotate(t);
+					t->left = erase_rebalance(t->left, true);
+					t = erase_rebalance(t, false);
+				}
+			}
+		}
+		else
+		{
+			if (t->left)
+			{
+				size_type right_weight = weight_of(t->right);
+				// case 3. weight(T.right) < weight(T.left.right)
+				if (t->left->right && right_weight < t->left->right->weight)
+				{
+					t->left = left_rotate(t->left);
+					t = right_rotate(t);
+					t->left = erase_rebalance(t->left, true);
+					t->right = erase_rebalance(t->right, false);
+					t = erase_rebalance(t, true);
+				}
+				// case 4. weight(T.right) < weight(T.left.left)
+				else if (t->left->left && right_weight < t->left->left->weight)
+				{
+					t = right_rotate(t);
+					t->right = erase_rebalance(t->right, false);
+					t = erase_rebalance(t, true);
+				}
+			}
+		}
+		return t;
+	}
+
+private:
+	node_pointer header;
+};
+
+#endif
@@ -0,0 +1,1373 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_COMPACT_TREE_H__
+#define __RULER_AB_COMPACT_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include "ab_tree.h"
+
+using ab_compact_tree_index = uint32_t;
+
+
+// Class template ab_compact_tree_node
+// Nodes live in an arena and are linked by their indices. Index 0 holds the
+// header, whose size is 0, and also stands for a missing child.
+template <class T>
+struct ab_compact_tree_node
+{
+	using node_type            = ab_compact_tree_node<T>;
+	using index_type           = ab_compact_tree_index;
+
+	index_type                 parent;
+	index_type                 left;
+	index_type                 right;
+	index_type                 size;
+	T                          data;
+};
+
+
+// Class template ab_compact_tree_iterator
+// The iterator holds the index of a node rather than its address, so that it
+// stays valid when the arena grows.
+template <class Tree, bool IsConst>
+class ab_compact_tree_iterator
+{
+	friend class ab_compact_tree_iterator<Tree, !IsConst>;
+
+public:
+	// types:
+
+	using value_type        = typename Tree::value_type;
+	using pointer           = typename std::conditional<IsConst, typename Tree::const_pointer, typename Tree::pointer>::type;
+	using reference         = typename std::conditional<IsConst, const value_type&, value_type&>::type;
+	using size_type         = typename Tree::size_type;
+	using difference_type   = typename Tree::difference_type;
+	using index_type        = typename Tree::index_type;
+	using tree_pointer      = typename std::conditional<IsConst, const Tree*, Tree*>::type;
+
+	using iterator_type     = ab_compact_tree_iterator<Tree, IsConst>;
+	using iterator_category = std::random_access_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_compact_tree_iterator(void) noexcept
+		: tree(nullptr)
+		, node(0)
+	{}
+	ab_compact_tree_iterator(tree_pointer tree, index_type node) noexcept
+		: tree(tree)
+		, node(node)
+	{}
+	ab_compact_tree_iterator(const ab_compact_tree_iterator<Tree, IsConst>& other) noexcept
+		: tree(other.tree)
+		, node(other.node)
+	{}
+
+	inline ab_compact_tree_iterator<Tree, IsConst>& operator=(const ab_compact_tree_iterator<Tree, IsConst>& other) noexcept
+	{
+		tree = other.tree;
+		node = other.node;
+		return *this;
+	}
+
+	inline operator ab_compact_tree_iterator<Tree, true>(void) const noexcept
+	{
+		return ab_compact_tree_iterator<Tree, true>(tree, node);
+	}
+
+	// ab_compact_tree_iterator operations:
+
+	inline index_type get_node(void) const noexcept
+	{
+		return node;
+	}
+
+	inline size_type get_index(void) const noexcept
+	{
+		return tree->index_of_node(node);
+	}
+
+	// increment / decrement
+
+	ab_compact_tree_iterator<Tree, IsConst>& operator++(void) noexcept
+	{
+		node = tree->next_node(node);
+		return *this;
+	}
+
+	ab_compact_tree_iterator<Tree, IsConst>& operator--(void) noexcept
+	{
+		node = tree->prev_node(node);
+		return *this;
+	}
+
+	inline ab_compact_tree_iterator<Tree, IsConst> operator++(int) noexcept
+	{
+		ab_compact_tree_iterator<Tree, IsConst> tmp(*this);
+		++*this;
+		return tmp;
+	}
+
+	inline ab_compact_tree_iterator<Tree, IsConst> operator--(int) noexcept
+	{
+		ab_compact_tree_iterator<Tree, IsConst> tmp(*this);
+		--*this;
+		return tmp;
+	}
+
+	// arithmetic operators:
+
+	inline ab_compact_tree_iterator<Tree, IsConst>& operator+=(difference_type n) noexcept
+	{
+		node = tree->select_node(static_cast<size_type>(static_cast<difference_type>(get_index()) + n));
+		return *this;
+	}
+
+	inline ab_compact_tree_iterator<Tree, IsConst>& operator-=(difference_type n) noexcept
+	{
+		return *this += -n;
+	}
+
+	inline ab_compact_tree_iterator<Tree, IsConst> operator+(difference_type n) const noexcept
+	{
+		ab_compact_tree_iterator<Tree, IsConst> tmp(*this);
+		return tmp += n;
+	}
+
+	inline ab_compact_tree_iterator<Tree, IsConst> operator-(difference_type n) const noexcept
+	{
+		ab_compact_tree_iterator<Tree, IsConst> tmp(*this);
+		return tmp -= n;
+	}
+
+	inline difference_type operator-(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return static_cast<difference_type>(get_index()) - static_cast<difference_type>(rhs.get_index());
+	}
+
+	// element access:
+
+	inline reference operator*(void) const noexcept
+	{
+		return tree->nodes[node].data;
+	}
+
+	inline pointer operator->(void) const noexcept
+	{
+		return std::addressof(tree->nodes[node].data);
+	}
+
+	inline reference operator[](difference_type n) const noexcept
+	{
+		return *(*this + n);
+	}
+
+	// relational operators:
+
+	inline bool operator==(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return node == rhs.node;
+	}
+
+	inline bool operator!=(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return node != rhs.node;
+	}
+
+	inline bool operator<(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return get_index() < rhs.get_index();
+	}
+
+	inline bool operator>(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return rhs < *this;
+	}
+
+	inline bool operator<=(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return !(rhs < *this);
+	}
+
+	inline bool operator>=(const ab_compact_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return !(*this < rhs);
+	}
+
+private:
+	tree_pointer tree;
+	index_type   node;
+};
+
+template <class Tree, bool IsConst>
+inline ab_compact_tree_iterator<Tree, IsConst> operator+(typename ab_compact_tree_iterator<Tree, IsConst>::difference_type n,
+	const ab_compact_tree_iterator<Tree, IsConst>& itr) noexcept
+{
+	return itr + n;
+}
+
+
+// Class template ab_compact_tree_node_allocator
+template <class T, class Allocator>
+class ab_compact_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_compact_tree_node<T>::node_type;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_compact_tree_node_allocator(void)
+		: allocator()
+		, node_alloc(allocator)
+	{}
+	explicit ab_compact_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+		, node_alloc(alloc)
+	{}
+	explicit ab_compact_tree_node_allocator(Allocator&& alloc)
+		: allocator(alloc)
+		, node_alloc(std::forward<Allocator>(alloc))
+	{}
+
+	~ab_compact_tree_node_allocator(void)
+	{}
+
+	// ab_compact_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		node_size_type n = node_traits_type::max_size(node_alloc);
+		// index 0 is taken by the header, and a size must fit in 32 bits
+		node_size_type m = static_cast<ab_compact_tree_index>(-1) - 1;
+		return n < m ? n : m;
+	}
+
+protected:
+
+	// allocates an arena of n nodes whose elements are not constructed
+	inline node_pointer allocate_nodes(size_t n)
+	{
+		return node_traits_type::allocate(node_alloc, n);
+	}
+
+	inline void deallocate_nodes(const node_pointer p, size_t n)
+	{
+		node_traits_type::deallocate(node_alloc, p, n);
+	}
+
+	template <class ...Args>
+	inline void construct_element(T* p, Args&&... args)
+	{
+		traits_type::construct(allocator, p, std::forward<Args>(args)...);
+	}
+
+	inline void destroy_element(T* p)
+	{
+		traits_type::destroy(allocator, p);
+	}
+
+	inline void swap_allocator(ab_compact_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_compact_tree
+// An ab-tree whose nodes are stored in a contiguous arena and linked by 32-bit
+// indices, which halves the overhead per element on 64-bit platforms. Growing
+// the arena relocates the elements, which invalidates references to them but
+// not iterators.
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_compact_tree : public ab_compact_tree_node_allocator<T, Allocator>
+{
+	friend class ab_compact_tree_iterator<ab_compact_tree<T, Allocator>, false>;
+	friend class ab_compact_tree_iterator<ab_compact_tree<T, Allocator>, true>;
+
+public:
+	// types:
+
+	using tree_type                        = ab_compact_tree<T, Allocator>;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_compact_tree_node<T>::node_type;
+	using node_pointer                     = node_type*;
+	using const_node_pointer               = const node_type*;
+	using index_type                       = ab_compact_tree_index;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_compact_tree_iterator<tree_type, false>;
+	using const_iterator                   = ab_compact_tree_iterator<tree_type, true>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+
+	// construct/copy/destroy:
+
+	explicit ab_compact_tree(const Allocator& alloc = Allocator())
+		: ab_compact_tree_node_allocator<T, Allocator>(alloc)
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		create_arena(initial_capacity);
+	}
+	ab_compact_tree(const tree_type& other)
+		: ab_compact_tree_node_allocator<T, Allocator>(other.get_allocator())
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		copy_arena(other);
+	}
+	// other keeps a new empty arena, so the move may throw bad_alloc
+	ab_compact_tree(tree_type&& other)
+		: ab_compact_tree_node_allocator<T, Allocator>(other.get_allocator())
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		create_arena(initial_capacity);
+		swap(other);
+	}
+	ab_compact_tree(size_type n, const_reference value, const Allocator& alloc = Allocator())
+		: ab_compact_tree_node_allocator<T, Allocator>(alloc)
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		if (n > this->max_size())
+			throw std::length_error(ABT_TOO_LONG);
+		create_arena(n < initial_capacity ? initial_capacity : n + 1);
+		assign(n, value);
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_compact_tree(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+		: ab_compact_tree_node_allocator<T, Allocator>(alloc)
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		create_arena(initial_capacity);
+		assign(first, last);
+	}
+	ab_compact_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+		: ab_compact_tree_node_allocator<T, Allocator>(alloc)
+		, nodes(nullptr)
+		, capacity(0)
+		, used(0)
+		, free_list(0)
+	{
+		create_arena(initial_capacity);
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_compact_tree(void)
+	{
+		destroy_arena();
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			tree_type tmp(other);
+			swap(tmp);
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		insert(cend(), n, value);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		insert(cend(), first, last);
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	// iterators:
+
+	inline iterator begin(void) noexcept
+	{
+		return iterator(this, nodes[0].left);
+	}
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(this, nodes[0].left);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(this, nodes[0].left);
+	}
+	inline iterator end(void) noexcept
+	{
+		return iterator(this, 0);
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(this, 0);
+	}
+	inline const_iterator cend(void) const noexcept
+	{
+		return const_iterator(this, 0);
+	}
+
+	inline reverse_iterator rbegin(void) noexcept
+	{
+		return reverse_iterator(end());
+	}
+	inline const_reverse_iterator rbegin(void) const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+	inline const_reverse_iterator crbegin(void) const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+	inline reverse_iterator rend(void) noexcept
+	{
+		return reverse_iterator(begin());
+	}
+	inline const_reverse_iterator rend(void) const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+	inline const_reverse_iterator crend(void) const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	// capacity:
+
+	inline bool empty(void) const noexcept
+	{
+		return !nodes[0].parent;
+	}
+
+	inline size_type size(void) const noexcept
+	{
+		return nodes[nodes[0].parent].size;
+	}
+
+	// reserves the arena for n elements
+	inline void reserve(size_type n)
+	{
+		if (n >= capacity)
+			grow_arena(n + 1);
+	}
+
+	// element access:
+
+	inline reference operator[](size_type idx) noexcept
+	{
+		return nodes[select_node(idx)].data;
+	}
+	inline const_reference operator[](size_type idx) const noexcept
+	{
+		return nodes[select_node(idx)].data;
+	}
+
+	inline reference at(size_type idx)
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return nodes[select_node(idx)].data;
+	}
+	inline const_reference at(size_type idx) const
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return nodes[select_node(idx)].data;
+	}
+
+	inline reference front(void)
+	{
+		return nodes[nodes[0].left].data;
+	}
+	inline const_reference front(void) const
+	{
+		return nodes[nodes[0].left].data;
+	}
+
+	inline reference back(void)
+	{
+		return nodes[nodes[0].right].data;
+	}
+	inline const_reference back(void) const
+	{
+		return nodes[nodes[0].right].data;
+	}
+
+	// modifiers:
+
+	template <class... Args>
+	inline void emplace_front(Args&&... args)
+	{
+		insert_node(0, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline void emplace_back(Args&&... args)
+	{
+		insert_node(size(), std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline iterator emplace(const_iterator pos, Args&&... args)
+	{
+		return iterator(this, insert_node(pos.get_index(), std::forward<Args>(args)...));
+	}
+	template <class... Args>
+	inline iterator emplace(size_type idx, Args&&... args)
+	{
+		return iterator(this, insert_node(idx, std::forward<Args>(args)...));
+	}
+
+	inline void push_front(const_reference value)
+	{
+		insert_node(0, value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		insert_node(0, std::move(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		insert_node(size(), value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		insert_node(size(), std::move(value));
+	}
+
+	inline void pop_front(void)
+	{
+		if (!empty())
+			erase_node(0);
+	}
+
+	inline void pop_back(void)
+	{
+		if (!empty())
+			erase_node(size() - 1);
+	}
+
+	inline iterator insert(const_iterator pos, const_reference value)
+	{
+		return emplace(pos, value);
+	}
+	inline iterator insert(const_iterator pos, value_type&& value)
+	{
+		return emplace(pos, std::move(value));
+	}
+	inline iterator insert(const_iterator pos, size_type n, const_reference value)
+	{
+		if (size() + n < capacity)
+			return insert_nodes(pos.get_index(), n, [&](T* p) { this->construct_element(p, value); });
+		// value may be an element of the arena that is about to be moved
+		value_type x(value);
+		return insert_nodes(pos.get_index(), n, [&](T* p) { this->construct_element(p, x); });
+	}
+	template <class InputIt>
+	inline iterator insert(const_iterator pos, InputIt first, InputIt last)
+	{
+		return insert_range(pos.get_index(), first, last, typename std::iterator_traits<InputIt>::iterator_category());
+	}
+	inline iterator insert(const_iterator pos, std::initializer_list<value_type> ilist)
+	{
+		return insert(pos, ilist.begin(), ilist.end());
+	}
+	inline iterator insert(size_type idx, const_reference value)
+	{
+		return emplace(idx, value);
+	}
+	inline iterator insert(size_type idx, value_type&& value)
+	{
+		return emplace(idx, std::move(value));
+	}
+	inline iterator insert(size_type idx, size_type n, const_reference value)
+	{
+		return insert(select(idx), n, value);
+	}
+	template <class InputIt>
+	inline iterator insert(size_type idx, InputIt first, InputIt last)
+	{
+		return insert(select(idx), first, last);
+	}
+	inline iterator insert(size_type idx, std::initializer_list<value_type> ilist)
+	{
+		return insert(idx, ilist.begin(), ilist.end());
+	}
+
+	inline iterator erase(const_iterator pos)
+	{
+		size_type idx = pos.get_index();
+		if (idx < size())
+			erase_node(idx);
+		return select(idx);
+	}
+	inline iterator erase(const_iterator first, const_iterator last)
+	{
+		size_type idx = first.get_index();
+		erase(idx, last.get_index() - idx);
+		return select(idx);
+	}
+	inline void erase(size_type idx)
+	{
+		if (idx < size())
+			erase_node(idx);
+	}
+	inline void erase(size_type idx, size_type n)
+	{
+		size_type count = size();
+		if (idx >= count)
+			return;
+		if (n > count - idx)
+			n = count - idx;
+		if (n == count)
+			clear();
+		else
+			while (n-- > 0)
+				erase_node(idx);
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(nodes, rhs.nodes);
+			std::swap(capacity, rhs.capacity);
+			std::swap(used, rhs.used);
+			std::swap(free_list, rhs.free_list);
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		destroy_elements();
+		used = 1;
+		free_list = 0;
+		nodes[0].parent = 0;
+		nodes[0].left = 0;
+		nodes[0].right = 0;
+	}
+
+	// operations:
+
+	inline iterator select(size_type idx) noexcept
+	{
+		return iterator(this, select_node(idx));
+	}
+	inline const_iterator select(size_type idx) const noexcept
+	{
+		return const_iterator(this, select_node(idx));
+	}
+
+	inline size_type index_of(const_iterator pos) const noexcept
+	{
+		return pos.get_index();
+	}
+
+private:
+
+	static constexpr index_type initial_capacity = 16;
+
+	inline index_type root(void) const noexcept
+	{
+		return nodes[0].parent;
+	}
+
+	inline index_type leftmost(index_type t) const noexcept
+	{
+		while (nodes[t].left)
+			t = nodes[t].left;
+		return t;
+	}
+
+	inline index_type rightmost(index_type t) const noexcept
+	{
+		while (nodes[t].right)
+			t = nodes[t].right;
+		return t;
+	}
+
+	// the arena:
+
+	static inline void copy_links(node_type& dst, const node_type& src) noexcept
+	{
+		dst.parent = src.parent;
+		dst.left = src.left;
+		dst.right = src.right;
+		dst.size = src.size;
+	}
+
+	void create_arena(size_type n)
+	{
+		nodes = this->allocate_nodes(n);
+		capacity = static_cast<index_type>(n);
+		used = 1;
+		free_list = 0;
+		nodes[0].parent = 0;
+		nodes[0].left = 0;
+		nodes[0].right = 0;
+		nodes[0].size = 0;
+	}
+
+	void destroy_arena(void)
+	{
+		if (nodes)
+		{
+			destroy_elements();
+			this->deallocate_nodes(nodes, capacity);
+			nodes = nullptr;
+		}
+	}
+
+	// destroys the elements in a linear sweep, free slots have size 0
+	void destroy_elements(void)
+	{
+		if (!std::is_trivially_destructible<T>::value)
+			for (index_type i = 1; i < used; ++i)
+				if (nodes[i].size)
+					this->destroy_element(std::addressof(nodes[i].data));
+	}
+
+	// moves the nodes into a new arena of at least n nodes
+	void grow_arena(size_type n)
+	{
+		if (n - 1 > this->max_size())
+			throw std::length_error(ABT_TOO_LONG);
+		node_pointer p = this->allocate_nodes(n);
+		try
+		{
+			move_nodes(p);
+		}
+		catch (...)
+		{
+			this->deallocate_nodes(p, n);
+			throw;
+		}
+		replace_arena(p, n);
+	}
+
+	// makes room for n more elements, growing the arena at least twofold while
+	// below max_size() so that a series of small insertions takes linear time
+	void reserve_more(size_type n)
+	{
+		size_type count = size();
+		if (n > static_cast<size_type>(this->max_size()) - count)
+			throw std::length_error(ABT_TOO_LONG);
+		if (count + n < capacity)
+			return;
+		size_type m = static_cast<size_type>(capacity) * 2;
+		if (m - 1 > this->max_size())
+			m = static_cast<size_type>(this->max_size()) + 1;
+		grow_arena(m > count + n ? m : count + n + 1);
+	}
+
+	// moves the nodes into a new arena, with room for more nodes while below
+	// max_size(), after constructing the next node by construct(p) in it, as
+	// its arguments may refer to an element in the old arena
+	template <class Constructor>
+	void grow_arena_with(Constructor& construct)
+	{
+		size_type n = static_cast<size_type>(capacity) * 2;
+		if (n - 1 > this->max_size())
+			n = static_cast<size_type>(this->max_size()) + 1;
+		if (n <= capacity)
+			throw std::length_error(ABT_TOO_LONG);
+		node_pointer p = this->allocate_nodes(n);
+		try
+		{
+			construct(std::addressof(p[used].data));
+		}
+		catch (...)
+		{
+			this->deallocate_nodes(p, n);
+			throw;
+		}
+		try
+		{
+			move_nodes(p);
+		}
+		catch (...)
+		{
+			this->destroy_element(std::addressof(p[used].data));
+			this->deallocate_nodes(p, n);
+			throw;
+		}
+		replace_arena(p, n);
+	}
+
+	// moves the used nodes into arena p, and destroys the moved elements if
+	// a move throws
+	void move_nodes(node_pointer p)
+	{
+		if (std::is_trivially_copyable<T>::value)
+			std::memcpy(static_cast<void*>(p), static_cast<const void*>(nodes), used * sizeof(node_type));
+		else
+		{
+			index_type i = 0;
+			try
+			{
+				for (; i < used; ++i)
+				{
+					copy_links(p[i], nodes[i]);
+					if (i && nodes[i].size)
+						this->construct_element(std::addressof(p[i].data), std::move_if_noexcept(nodes[i].data));
+				}
+			}
+			catch (...)
+			{
+				while (i-- > 1)
+					if (p[i].size)
+						this->destroy_element(std::addressof(p[i].data));
+				throw;
+			}
+			destroy_elements();
+		}
+	}
+
+	inline void replace_arena(node_pointer p, size_type n) noexcept
+	{
+		this->deallocate_nodes(nodes, capacity);
+		nodes = p;
+		capacity = static_cast<index_type>(n);
+	}
+
+	// copies the arena of other slot by slot, which keeps its shape
+	void copy_arena(const tree_type& other)
+	{
+		create_arena(other.used > initial_capacity ? other.used : initial_capacity);
+		index_type i = 1;
+		try
+		{
+			for (; i < other.used; ++i)
+			{
+				copy_links(nodes[i], other.nodes[i]);
+				if (nodes[i].size)
+					this->construct_element(std::addressof(nodes[i].data), other.nodes[i].data);
+			}
+		}
+		catch (...)
+		{
+			used = i;
+			destroy_arena();
+			throw;
+		}
+		used = other.used;
+		free_list = other.free_list;
+		copy_links(nodes[0], other.nodes[0]);
+	}
+
+	// takes a free slot, the element is constructed by construct(p)
+	template <class Constructor>
+	index_type create_node(Constructor& construct)
+	{
+		index_type t = free_list;
+		if (!t)
+		{
+			t = used;
+			if (used == capacity)
+				grow_arena_with(construct);
+			else
+				construct(std::addressof(nodes[t].data));
+		}
+		else
+			construct(std::addressof(nodes[t].data));
+		if (t == used)
+			++used;
+		else
+			free_list = nodes[t].parent;
+		nodes[t].parent = 0;
+		nodes[t].left = 0;
+		nodes[t].right = 0;
+		nodes[t].size = 1;
+		return t;
+	}
+
+	inline void destroy_node(index_type t)
+	{
+		this->destroy_element(std::addressof(nodes[t].data));
+		nodes[t].size = 0;
+		nodes[t].parent = free_list;
+		free_list = t;
+	}
+
+	// navigation:
+
+	index_type select_node(size_type k) const noexcept
+	{
+		index_type t = nodes[0].parent;
+		while (t)
+		{
+			size_type left_size = nodes[nodes[t].left].size;
+			if (k < left_size)
+				t = nodes[t].left;
+			else if (k > left_size)
+			{
+				k -= left_size + 1;
+				t = nodes[t].right;
+			}
+			else
+				break;
+		}
+		return t;
+	}
+
+	size_type index_of_node(index_type t) const noexcept
+	{
+		if (!t)
+			return size();
+		size_type idx = nodes[nodes[t].left].size;
+		for (index_type p = nodes[t].parent; p; t = p, p = nodes[p].parent)
+			if (t == nodes[p].right)
+				idx += nodes[nodes[p].left].size + 1;
+		return idx;
+	}
+
+	index_type next_node(index_type t) const noexcept
+	{
+		if (nodes[t].right)
+			return leftmost(nodes[t].right);
+		index_type p = nodes[t].parent;
+		while (p && t == nodes[p].right)
+		{
+			t = p;
+			p = nodes[p].parent;
+		}
+		return p;
+	}
+
+	index_type prev_node(index_type t) const noexcept
+	{
+		if (!t)
+			return nodes[0].right;
+		if (nodes[t].left)
+			return rightmost(nodes[t].left);
+		index_type p = nodes[t].parent;
+		while (p && t == nodes[p].left)
+		{
+			t = p;
+			p = nodes[p].parent;
+		}
+		return p;
+	}
+
+	// insertion and deletion:
+
+	template <class... Args>
+	index_type insert_node(size_type idx, Args&&... args)
+	{
+		auto construct = [&](T* p) { this->construct_element(p, std::forward<Args>(args)...); };
+		index_type n = create_node(construct);
+		link_node(idx, n);
+		return n;
+	}
+
+	// links the new node n at index idx
+	void link_node(size_type idx, index_type n)
+	{
+		size_type count = size();
+		index_type t = insert_subtree(nodes[0].parent, idx, n);
+		nodes[t].parent = 0;
+		nodes[0].parent = t;
+		if (idx == 0)
+			nodes[0].left = n;
+		if (idx == count)
+			nodes[0].right = n;
+	}
+
+	template <class Constructor>
+	iterator insert_nodes(size_type idx, size_type n, Constructor construct)
+	{
+		if (n == 0)
+			return select(idx);
+		reserve_more(n);
+		if (empty())
+		{
+			index_type t = build_subtree(n, construct);
+			nodes[t].parent = 0;
+			nodes[0].parent = t;
+			nodes[0].left = leftmost(t);
+			nodes[0].right = rightmost(t);
+			return begin();
+		}
+		index_type first = create_node(construct);
+		link_node(idx, first);
+		for (size_type i = 1; i < n; ++i)
+			link_node(idx + i, create_node(construct));
+		return iterator(this, first);
+	}
+
+	template <class InputIt>
+	iterator insert_range(size_type idx, InputIt first, InputIt last, std::input_iterator_tag)
+	{
+		size_type count = size();
+		for (size_type i = idx; first != last; ++first, ++i)
+			insert_node(i, *first);
+		return select(idx < count ? idx : count);
+	}
+
+	template <class ForwardIt>
+	iterator insert_range(size_type idx, ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+	{
+		return insert_nodes(idx, static_cast<size_type>(std::distance(first, last)),
+			[&](T* p) { this->construct_element(p, *first++); });
+	}
+
+	// builds a perfectly balanced subtree of n nodes, whose slots follow one
+	// another in order if the arena has no free slots
+	template <class Constructor>
+	index_type build_subtree(size_type n, Constructor& construct)
+	{
+		if (n == 0)
+			return 0;
+		index_type l = build_subtree((n - 1) / 2, construct);
+		index_type t;
+		try
+		{
+			t = create_node(construct);
+		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			throw;
+		}
+		nodes[t].left = l;
+		index_type r;
+		try
+		{
+			r = build_subtree(n - 1 - (n - 1) / 2, construct);
+		}
+		catch (...)
+		{
+			destroy_subtree(t);
+			throw;
+		}
+		nodes[t].right = r;
+		nodes[t].size = static_cast<index_type>(n);
+		if (l)
+			nodes[l].parent = t;
+		if (r)
+			nodes[r].parent = t;
+		return t;
+	}
+
+	// returns the slots of subtree t, which is not linked to the tree, to the
+	// free list
+	void destroy_subtree(index_type t)
+	{
+		while (t)
+		{
+			destroy_subtree(nodes[t].right);
+			index_type l = nodes[t].left;
+			destroy_node(t);
+			t = l;
+		}
+	}
+
+	// inserts node n at index idx of subtree t and returns its new root
+	index_type insert_subtree(index_type t, size_type idx, index_type n)
+	{
+		if (!t)
+			return n;
+		++nodes[t].size;
+		size_type left_size = nodes[nodes[t].left].size;
+		index_type c;
+		if (idx <= left_size)
+		{
+			c = insert_subtree(nodes[t].left, idx, n);
+			nodes[t].left = c;
+		}
+		else
+		{
+			c = insert_subtree(nodes[t].right, idx - left_size - 1, n);
+			nodes[t].right = c;
+		}
+		nodes[c].parent = t;
+		return rebalance_node(t, idx > left_size);
+	}
+
+	void erase_node(size_type idx)
+	{
+		size_type count = size();
+		index_type t = erase_subtree(nodes[0].parent, idx);
+		nodes[0].parent = t;
+		if (t)
+		{
+			nodes[t].parent = 0;
+			if (idx == 0)
+				nodes[0].left = leftmost(t);
+			if (idx == count - 1)
+				nodes[0].right = rightmost(t);
+		}
+		else
+		{
+			nodes[0].left = 0;
+			nodes[0].right = 0;
+		}
+	}
+
+	// erases the node at index idx of subtree t and returns its new root
+	index_type erase_subtree(index_type t, size_type idx)
+	{
+		size_type left_size = nodes[nodes[t].left].size;
+		index_type c;
+		if (idx < left_size)
+		{
+			c = erase_subtree(nodes[t].left, idx);
+			nodes[t].left = c;
+			if (c)
+				nodes[c].parent = t;
+			--nodes[t].size;
+			return rebalance_node(t, true);
+		}
+		if (idx > left_size)
+		{
+			c = erase_subtree(nodes[t].right, idx - left_size - 1);
+			nodes[t].right = c;
+			if (c)
+				nodes[c].parent = t;
+			--nodes[t].size;
+			return rebalance_node(t, false);
+		}
+		index_type l = nodes[t].left;
+		index_type r = nodes[t].right;
+		if (!l)
+			c = r;
+		else if (!r)
+			c = l;
+		else
+		{
+			// replaces t by its neighbour in the larger subtree
+			bool flag = nodes[l].size > nodes[r].size;
+			if (flag)
+				l = extract_last(l, c);
+			else
+				r = extract_first(r, c);
+			nodes[c].left = l;
+			nodes[c].right = r;
+			nodes[c].size = nodes[t].size - 1;
+			if (l)
+				nodes[l].parent = c;
+			if (r)
+				nodes[r].parent = c;
+			c = rebalance_node(c, flag);
+		}
+		destroy_node(t);
+		return c;
+	}
+
+	// unlinks the first node m of subtree t and returns the new root
+	index_type extract_first(index_type t, index_type& m)
+	{
+		if (!nodes[t].left)
+		{
+			m = t;
+			return nodes[t].right;
+		}
+		index_type c = extract_first(nodes[t].left, m);
+		nodes[t].left = c;
+		if (c)
+			nodes[c].parent = t;
+		--nodes[t].size;
+		return rebalance_node(t, true);
+	}
+
+	// unlinks the last node m of subtree t and returns the new root
+	index_type extract_last(index_type t, index_type& m)
+	{
+		if (!nodes[t].right)
+		{
+			m = t;
+			return nodes[t].left;
+		}
+		index_type c = extract_last(nodes[t].right, m);
+		nodes[t].right = c;
+		if (c)
+			nodes[c].parent = t;
+		--nodes[t].size;
+		return rebalance_node(t, false);
+	}
+
+	// rotations and rebalancing, the new root keeps the parent of t:
+
+	index_type left_rotate(index_type t) noexcept
+	{
+		index_type r = nodes[t].right;
+		index_type b = nodes[r].left;
+		nodes[t].right = b;
+		if (b)
+			nodes[b].parent = t;
+		nodes[r].parent = nodes[t].parent;
+		nodes[r].left = t;
+		nodes[t].parent = r;
+		nodes[r].size = nodes[t].size;
+		nodes[t].size = nodes[nodes[t].left].size + nodes[b].size + 1;
+		return r;
+	}
+
+	index_type right_rotate(index_type t) noexcept
+	{
+		index_type l = nodes[t].left;
+		index_type b = nodes[l].right;
+		nodes[t].left = b;
+		if (b)
+			nodes[b].parent = t;
+		nodes[l].parent = nodes[t].parent;
+		nodes[l].right = t;
+		nodes[t].parent = l;
+		nodes[l].size = nodes[t].size;
+		nodes[t].size = nodes[b].size + nodes[nodes[t].right].size + 1;
+		return l;
+	}
+
+	// restores the balance of t after its right subtree grew if flag is
+	// true, or its left subtree grew otherwise, and returns the new root
+	index_type rebalance_node(index_type t, bool flag) noexcept
+	{
+		if (flag)
+		{
+			index_type r = nodes[t].right;
+			if (r)
+			{
+				size_type left_size = nodes[nodes[t].left].size;
+				// case 1: size(T.left) < size(T.right.left)
+				if (left_size < nodes[nodes[r].left].size)
+				{
+					nodes[t].right = right_rotate(r);
+					t = left_rotate(t);
+					nodes[t].left = rebalance_node(nodes[t].left, false);
+					nodes[t].right = rebalance_node(nodes[t].right, true);
+					t = rebalance_node(t, true);
+				}
+				// case 2. size(T.left) < size(T.right.right)
+				else if (left_size < nodes[nodes[r].right].size)
+				{
+					t = left_rotate(t);
+					nodes[t].left = rebalance_node(nodes[t].left, false);
+					t = rebalance_node(t, true);
+				}
+			}
+		}
+		else
+		{
+			index_type l = nodes[t].left;
+			if (l)
+			{
+				size_type right_size = nodes[nodes[t].right].size;
+				// case 3. size(T.right) < size(T.left.right)
+				if (right_size < nodes[nodes[l].right].size)
+				{
+					nodes[t].left = left_rotate(l);
+					t = right_rotate(t);
+					nodes[t].left = rebalance_node(nodes[t].left, false);
+					nodes[t].right = rebalance_node(nodes[t].right, true);
+					t = rebalance_node(t, false);
+				}
+				// case 4. size(T.right) < size(T.left.left)
+				else if (right_size < nodes[nodes[l].left].size)
+				{
+					t = right_rotate(t);
+					nodes[t].right = rebalance_node(nodes[t].right, true);
+					t = rebalance_node(t, false);
+				}
+			}
+		}
+		return t;
+	}
+
+private:
+	node_pointer nodes;
+	index_type   capacity;
+	index_type   used;
+	index_type   free_list;
+};
+
+#endif
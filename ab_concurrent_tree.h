@@ -0,0 +1,447 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_CONCURRENT_TREE_H__
+#define __RULER_AB_CONCURRENT_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <mutex>
+#include <shared_mutex>
+#include "ab_tree.h"
+#include "ab_monoid_tree.h"
+
+// Class template ab_concurrent_shard
+// A run of consecutive elements of an ab_concurrent_tree under its own lock.
+template <class Tree>
+struct ab_concurrent_shard
+{
+	explicit ab_concurrent_shard(const typename Tree::allocator_type& alloc)
+		: tree(alloc)
+	{}
+
+	std::shared_mutex mutex;
+	Tree              tree;
+};
+
+
+// Class template ab_concurrent_entry
+// A shard in the directory, whose size is updated under the lock of the
+// directory before the shard itself is modified.
+template <class Shard>
+struct ab_concurrent_entry
+{
+	Shard* shard;
+	size_t size;
+};
+
+
+// Class template ab_concurrent_size_sum
+template <class Entry>
+struct ab_concurrent_size_sum
+{
+	using value_type = size_t;
+
+	inline value_type identity(void) const
+	{
+		return 0;
+	}
+
+	inline value_type lift(const Entry& x) const
+	{
+		return x.size;
+	}
+
+	inline value_type combine(const value_type& a, const value_type& b) const
+	{
+		return a + b;
+	}
+};
+
+
+// Class template ab_concurrent_tree
+// An array split into shards of consecutive elements, each an ab_tree under
+// its own lock, so that threads working on different shards run in parallel.
+// A directory of the shards, an ab_monoid_tree summing their sizes, maps an
+// index to its shard under a short lock, which is handed over to the lock of
+// the shard before it is released. Each operation therefore takes effect in
+// the order it held the directory lock. A shard is split once it holds more
+// than twice shard_size elements, and merged into a neighbour once it holds
+// fewer than a quarter.
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_concurrent_tree
+{
+	static_assert(ab_tree_concurrent_allocator<Allocator>::value, "The allocator of a concurrent AB-Tree must be thread-safe.");
+
+public:
+	// types:
+
+	using tree_type       = ab_tree<T, Allocator>;
+	using allocator_type  = typename tree_type::allocator_type;
+	using value_type      = typename tree_type::value_type;
+	using reference       = typename tree_type::reference;
+	using const_reference = typename tree_type::const_reference;
+	using size_type       = typename tree_type::size_type;
+	using difference_type = typename tree_type::difference_type;
+
+	static constexpr size_type default_shard_size = 4096;
+
+	// construct/copy/destroy:
+
+	explicit ab_concurrent_tree(size_type shard_size = default_shard_size, const Allocator& alloc = Allocator())
+		: allocator(alloc)
+		, shard_size(shard_size < 4 ? 4 : shard_size)
+	{
+		append_shard();
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_concurrent_tree(InputIt first, InputIt last, size_type shard_size = default_shard_size, const Allocator& alloc = Allocator())
+		: ab_concurrent_tree(shard_size, alloc)
+	{
+		for (; first != last; ++first)
+		{
+			size_type n = directory.size() - 1;
+			shard_type* s = directory[n].shard;
+			if (s->tree.size() == this->shard_size)
+			{
+				s = append_shard();
+				++n;
+			}
+			s->tree.push_back(*first);
+			directory.modify(n, [](entry_type& e) { ++e.size; });
+		}
+	}
+	ab_concurrent_tree(const ab_concurrent_tree&) = delete;
+
+	~ab_concurrent_tree(void)
+	{
+		for (const entry_type& e : directory)
+			delete e.shard;
+	}
+
+	ab_concurrent_tree& operator=(const ab_concurrent_tree&) = delete;
+
+	inline allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	// capacity:
+
+	inline bool empty(void) const
+	{
+		return size() == 0;
+	}
+
+	inline size_type size(void) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return directory.reduce();
+	}
+
+	inline size_type shard_count(void) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return directory.size();
+	}
+
+	// element access:
+
+	// returns a copy of the element at index idx
+	value_type at(size_type idx) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (idx >= directory.reduce())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		size_type pos;
+		shard_type* s = directory[locate(idx, false, pos)].shard;
+		std::shared_lock<std::shared_mutex> shard_lock(s->mutex);
+		lock.unlock();
+		return s->tree[pos];
+	}
+
+	// calls f on the element at index idx while no thread can modify it, and
+	// returns false if there is no such element
+	template <class Function>
+	bool visit(size_type idx, Function f) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (idx >= directory.reduce())
+			return false;
+		size_type pos;
+		shard_type* s = directory[locate(idx, false, pos)].shard;
+		std::shared_lock<std::shared_mutex> shard_lock(s->mutex);
+		lock.unlock();
+		f(static_cast<const_reference>(s->tree[pos]));
+		return true;
+	}
+
+	// modifiers:
+
+	// calls f to modify the element at index idx while no other thread can
+	// access it, and returns false if there is no such element
+	template <class Function>
+	bool modify(size_type idx, Function f)
+	{
+		// the sizes do not change, so the directory is only read
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (idx >= directory.reduce())
+			return false;
+		size_type pos;
+		shard_type* s = directory[locate(idx, false, pos)].shard;
+		std::unique_lock<std::shared_mutex> shard_lock(s->mutex);
+		lock.unlock();
+		f(s->tree[pos]);
+		return true;
+	}
+
+	inline bool set(size_type idx, const_reference value)
+	{
+		return modify(idx, [&](reference x) { x = value; });
+	}
+	inline bool set(size_type idx, value_type&& value)
+	{
+		return modify(idx, [&](reference x) { x = std::move(value); });
+	}
+
+	// inserts an element before index idx, or at the end if idx is beyond it
+	template <class ...Args>
+	void emplace(size_type idx, Args&&... args)
+	{
+		// the element is made before any lock is taken, so a throwing
+		// constructor leaves the tree unchanged and blocks no other thread
+		tree_type one(allocator);
+		one.emplace_back(std::forward<Args>(args)...);
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		size_type count = directory.reduce();
+		size_type pos;
+		size_type n = locate(idx < count ? idx : count, true, pos);
+		shard_type* s = directory[n].shard;
+		directory.modify(n, [](entry_type& e) { ++e.size; });
+		std::unique_lock<std::shared_mutex> shard_lock(s->mutex);
+		lock.unlock();
+		s->tree.splice(pos, std::move(one));
+		bool full = s->tree.size() > 2 * shard_size;
+		shard_lock.unlock();
+		if (full)
+			split_shard(s);
+	}
+	template <class ...Args>
+	inline void emplace_front(Args&&... args)
+	{
+		emplace(0, std::forward<Args>(args)...);
+	}
+	template <class ...Args>
+	inline void emplace_back(Args&&... args)
+	{
+		emplace(static_cast<size_type>(-1), std::forward<Args>(args)...);
+	}
+
+	inline void insert(size_type idx, const_reference value)
+	{
+		emplace(idx, value);
+	}
+	inline void insert(size_type idx, value_type&& value)
+	{
+		emplace(idx, std::move(value));
+	}
+
+	inline void push_front(const_reference value)
+	{
+		emplace_front(value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		emplace_front(std::move(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		emplace_back(value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		emplace_back(std::move(value));
+	}
+
+	// erases the element at index idx, and returns false if there is none
+	bool erase(size_type idx)
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		if (idx >= directory.reduce())
+			return false;
+		size_type pos;
+		size_type n = locate(idx, false, pos);
+		shard_type* s = directory[n].shard;
+		bool alone = directory.size() == 1;
+		directory.modify(n, [](entry_type& e) { --e.size; });
+		std::unique_lock<std::shared_mutex> shard_lock(s->mutex);
+		lock.unlock();
+		s->tree.erase(pos);
+		bool sparse = !alone && s->tree.size() < shard_size / 4;
+		shard_lock.unlock();
+		if (sparse)
+			merge_shard(s);
+		return true;
+	}
+
+	void clear(void)
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		// waits for the threads still modifying a shard
+		for (const entry_type& e : directory)
+			std::unique_lock<std::shared_mutex> shard_lock(e.shard->mutex);
+		while (directory.size() > 1)
+		{
+			delete directory.back().shard;
+			directory.pop_back();
+		}
+		directory.modify(0, [](entry_type& e) { e.size = 0; });
+		directory.front().shard->tree.clear();
+	}
+
+	// operations:
+
+	// calls f on each element in order, while no thread can modify the tree
+	template <class Function>
+	void for_each(Function f) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		for (const entry_type& e : directory)
+		{
+			std::shared_lock<std::shared_mutex> shard_lock(e.shard->mutex);
+			for (const_reference x : e.shard->tree)
+				f(x);
+		}
+	}
+
+private:
+
+	using shard_type     = ab_concurrent_shard<tree_type>;
+	using entry_type     = ab_concurrent_entry<shard_type>;
+	using directory_type = ab_monoid_tree<entry_type, ab_concurrent_size_sum<entry_type>, ab_tree_no_action,
+		typename std::allocator_traits<Allocator>::template rebind_alloc<entry_type>>;
+
+	inline shard_type* append_shard(void)
+	{
+		std::unique_ptr<shard_type> s(new shard_type(allocator));
+		directory.push_back(entry_type{ s.get(), 0 });
+		return s.release();
+	}
+
+	// finds the shard holding index idx and the index pos in it, where an
+	// index between two shards is at the end of the first if inserting
+	inline size_type locate(size_type idx, bool inserting, size_type& pos) const
+	{
+		// the sizes of the shards before the found one make the largest sum
+		// for which the predicate is false, so no second descent is needed
+		size_type before = 0;
+		size_type n = directory.find_prefix([&](size_type sum)
+		{
+			bool found = inserting ? sum >= idx : sum > idx;
+			if (!found && before < sum)
+				before = sum;
+			return found;
+		});
+		pos = idx - before;
+		return n;
+	}
+
+	// returns the position of shard s in the directory, or its size if s was
+	// merged away in the meantime
+	inline size_type find_shard(const shard_type* s) const noexcept
+	{
+		size_type n = 0;
+		for (const entry_type& e : directory)
+		{
+			if (e.shard == s)
+				break;
+			++n;
+		}
+		return n;
+	}
+
+	// moves the second half of shard s into a new shard after it
+	void split_shard(shard_type* s)
+	{
+		try
+		{
+			std::unique_ptr<shard_type> fresh(new shard_type(allocator));
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			size_type n = find_shard(s);
+			if (n == directory.size())
+				return;
+			std::unique_lock<std::shared_mutex> shard_lock(s->mutex);
+			size_type count = s->tree.size();
+			if (count <= 2 * shard_size)
+				return;
+			directory.insert(n + 1, entry_type{ fresh.get(), count - count / 2 });
+			fresh->tree = s->tree.split(count / 2);
+			directory.modify(n, [&](entry_type& e) { e.size = count / 2; });
+			fresh.release();
+		}
+		catch (...)
+		{
+			// a shard that cannot be split stays large, which is still correct
+		}
+	}
+
+	// concatenates shard s with its next neighbour, or its previous one if
+	// it is the last, and drops the emptied shard
+	void merge_shard(shard_type* s)
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		size_type n = find_shard(s);
+		if (n == directory.size() || directory.size() == 1)
+			return;
+		if (n + 1 == directory.size())
+			--n;
+		shard_type* a = directory[n].shard;
+		shard_type* b = directory[n + 1].shard;
+		{
+			std::unique_lock<std::shared_mutex> a_lock(a->mutex);
+			std::unique_lock<std::shared_mutex> b_lock(b->mutex);
+			if (s->tree.size() >= shard_size / 4)
+				return;
+			a->tree.concat(std::move(b->tree));
+			directory.modify(n, [&](entry_type& e) { e.size = a->tree.size(); });
+			directory.erase(n + 1);
+		}
+		delete b;
+	}
+
+private:
+	allocator_type            allocator;
+	size_type                 shard_size;
+	mutable std::shared_mutex mutex;
+	directory_type            directory;
+};
+
+#endif
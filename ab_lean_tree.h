@@ -0,0 +1,1081 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_LEAN_TREE_H__
+#define __RULER_AB_LEAN_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <utility>
+#include "ab_tree.h"
+
+
+// Class template ab_lean_tree_node
+template <class T>
+struct ab_lean_tree_node
+{
+	using node_type            = ab_lean_tree_node<T>;
+	using node_pointer         = node_type*;
+	using const_node_pointer   = const node_type*;
+	using node_reference       = node_type&;
+	using const_node_reference = const node_type&;
+
+	node_pointer               left;
+	node_pointer               right;
+	size_t                     size;
+	T                          data;
+};
+
+
+// Class template ab_lean_tree_iterator
+// Nodes have no parent, so the iterator keeps the path from the root to the
+// current node, whose depth is bounded by the balance of the tree.
+template <class Tree, bool IsConst>
+class ab_lean_tree_iterator
+{
+	friend class ab_lean_tree_iterator<Tree, !IsConst>;
+
+public:
+	// types:
+
+	using value_type        = typename Tree::value_type;
+	using pointer           = typename std::conditional<IsConst, typename Tree::const_pointer, typename Tree::pointer>::type;
+	using reference         = typename std::conditional<IsConst, const value_type&, value_type&>::type;
+	using size_type         = typename Tree::size_type;
+	using difference_type   = typename Tree::difference_type;
+	using node_type         = typename Tree::node_type;
+	using node_pointer      = typename Tree::node_pointer;
+
+	using iterator_type     = ab_lean_tree_iterator<Tree, IsConst>;
+	using iterator_category = std::random_access_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_lean_tree_iterator(void) noexcept
+		: root(nullptr)
+		, node(nullptr)
+		, depth(0)
+	{}
+	// points to the node at index idx, or past the last node
+	ab_lean_tree_iterator(const node_pointer t, size_type idx) noexcept
+		: root(t)
+		, node(nullptr)
+		, depth(0)
+	{
+		seek(idx);
+	}
+	ab_lean_tree_iterator(const ab_lean_tree_iterator<Tree, IsConst>& other) noexcept
+		: root(other.root)
+		, node(other.node)
+		, depth(other.depth)
+	{
+		for (size_t i = 0; i < depth; ++i)
+			path[i] = other.path[i];
+	}
+	template <bool OtherConst, class = typename std::enable_if<IsConst && !OtherConst>::type>
+	ab_lean_tree_iterator(const ab_lean_tree_iterator<Tree, OtherConst>& other) noexcept
+		: root(other.root)
+		, node(other.node)
+		, depth(other.depth)
+	{
+		for (size_t i = 0; i < depth; ++i)
+			path[i] = other.path[i];
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst>& operator=(const ab_lean_tree_iterator<Tree, IsConst>& other) noexcept
+	{
+		if (this != &other)
+		{
+			root = other.root;
+			node = other.node;
+			depth = other.depth;
+			for (size_t i = 0; i < depth; ++i)
+				path[i] = other.path[i];
+		}
+		return *this;
+	}
+
+	// ab_lean_tree_iterator operations:
+
+	inline node_pointer get_pointer(void) const noexcept
+	{
+		return node;
+	}
+
+	// sums the nodes on the left of the path
+	size_type get_index(void) const noexcept
+	{
+		if (!depth)
+			return root ? root->size : 0;
+		size_type idx = Tree::size_of(node->left);
+		for (size_t i = 1; i < depth; ++i)
+			if (path[i - 1]->right == path[i])
+				idx += Tree::size_of(path[i - 1]->left) + 1;
+		return idx;
+	}
+
+	// increment / decrement
+
+	ab_lean_tree_iterator<Tree, IsConst>& operator++(void) noexcept
+	{
+		node_pointer t = node;
+		if (t->right)
+			push_left(t->right);
+		else
+		{
+			// climbs until the node is a left child
+			do
+				t = path[--depth];
+			while (depth && path[depth - 1]->right == t);
+			node = depth ? path[depth - 1] : nullptr;
+		}
+		return *this;
+	}
+
+	ab_lean_tree_iterator<Tree, IsConst>& operator--(void) noexcept
+	{
+		if (!depth)
+			push_right(root);
+		else
+		{
+			node_pointer t = node;
+			if (t->left)
+				push_right(t->left);
+			else
+			{
+				// climbs until the node is a right child
+				do
+					t = path[--depth];
+				while (depth && path[depth - 1]->left == t);
+				node = depth ? path[depth - 1] : nullptr;
+			}
+		}
+		return *this;
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst> operator++(int) noexcept
+	{
+		ab_lean_tree_iterator<Tree, IsConst> tmp(*this);
+		++*this;
+		return tmp;
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst> operator--(int) noexcept
+	{
+		ab_lean_tree_iterator<Tree, IsConst> tmp(*this);
+		--*this;
+		return tmp;
+	}
+
+	// arithmetic operators:
+
+	inline ab_lean_tree_iterator<Tree, IsConst>& operator+=(difference_type n) noexcept
+	{
+		seek(static_cast<size_type>(static_cast<difference_type>(get_index()) + n));
+		return *this;
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst>& operator-=(difference_type n) noexcept
+	{
+		return *this += -n;
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst> operator+(difference_type n) const noexcept
+	{
+		ab_lean_tree_iterator<Tree, IsConst> tmp(*this);
+		return tmp += n;
+	}
+
+	inline ab_lean_tree_iterator<Tree, IsConst> operator-(difference_type n) const noexcept
+	{
+		ab_lean_tree_iterator<Tree, IsConst> tmp(*this);
+		return tmp -= n;
+	}
+
+	inline difference_type operator-(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return static_cast<difference_type>(get_index()) - static_cast<difference_type>(rhs.get_index());
+	}
+
+	// element access:
+
+	inline reference operator*(void) const noexcept
+	{
+		return node->data;
+	}
+
+	inline pointer operator->(void) const noexcept
+	{
+		return std::addressof(node->data);
+	}
+
+	inline reference operator[](difference_type n) const noexcept
+	{
+		return *(*this + n);
+	}
+
+	// relational operators:
+
+	inline bool operator==(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return get_pointer() == rhs.get_pointer();
+	}
+
+	inline bool operator!=(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return get_pointer() != rhs.get_pointer();
+	}
+
+	inline bool operator<(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return get_index() < rhs.get_index();
+	}
+
+	inline bool operator>(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return rhs < *this;
+	}
+
+	inline bool operator<=(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return !(rhs < *this);
+	}
+
+	inline bool operator>=(const ab_lean_tree_iterator<Tree, IsConst>& rhs) const noexcept
+	{
+		return !(*this < rhs);
+	}
+
+private:
+
+	// rebuilds the path to index idx from the root
+	void seek(size_type idx) noexcept
+	{
+		depth = 0;
+		node = nullptr;
+		node_pointer t = root;
+		if (!t || idx >= t->size)
+			return;
+		while (true)
+		{
+			path[depth++] = t;
+			size_type left_size = Tree::size_of(t->left);
+			if (idx < left_size)
+				t = t->left;
+			else if (idx > left_size)
+			{
+				idx -= left_size + 1;
+				t = t->right;
+			}
+			else
+				break;
+		}
+		node = t;
+	}
+
+	inline void push_left(node_pointer t) noexcept
+	{
+		for (; t; t = t->left)
+			path[depth++] = node = t;
+	}
+
+	inline void push_right(node_pointer t) noexcept
+	{
+		for (; t; t = t->right)
+			path[depth++] = node = t;
+	}
+
+private:
+	node_pointer root;
+	node_pointer node;
+	size_t       depth;
+	node_pointer path[ab_tree_max_depth];
+};
+
+template <class Tree, bool IsConst>
+inline ab_lean_tree_iterator<Tree, IsConst> operator+(typename ab_lean_tree_iterator<Tree, IsConst>::difference_type n,
+	const ab_lean_tree_iterator<Tree, IsConst>& itr) noexcept
+{
+	return itr + n;
+}
+
+
+// Class template ab_lean_tree_node_allocator
+template <class T, class Allocator>
+class ab_lean_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_lean_tree_node<T>::node_type;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_lean_tree_node_allocator(void)
+		: allocator()
+		, node_alloc()
+	{}
+	explicit ab_lean_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+		, node_alloc(alloc)
+	{}
+
+	~ab_lean_tree_node_allocator(void)
+	{}
+
+	// ab_lean_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		return node_traits_type::max_size(node_alloc);
+	}
+
+protected:
+
+	template <class ...Args>
+	inline node_pointer create_node(Args&&... args)
+	{
+		node_pointer p = node_traits_type::allocate(node_alloc, 1);
+		try
+		{
+			traits_type::construct(allocator, std::addressof(p->data), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits_type::deallocate(node_alloc, p, 1);
+			throw;
+		}
+		p->left = nullptr;
+		p->right = nullptr;
+		p->size = 1;
+		return p;
+	}
+
+	inline void destroy_node(const node_pointer p)
+	{
+		traits_type::destroy(allocator, std::addressof(p->data));
+		node_traits_type::deallocate(node_alloc, p, 1);
+	}
+
+	inline void swap_allocator(ab_lean_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_lean_tree
+// An ab-tree whose nodes have no parent pointer. Modifications descend from the
+// root and rebalance on the way back, and iterators keep their path, so nodes
+// are a quarter smaller and rotations store half as many links.
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_lean_tree : public ab_lean_tree_node_allocator<T, Allocator>
+{
+	friend class ab_lean_tree_iterator<ab_lean_tree<T, Allocator>, false>;
+	friend class ab_lean_tree_iterator<ab_lean_tree<T, Allocator>, true>;
+
+public:
+	// types:
+
+	using tree_type                        = ab_lean_tree<T, Allocator>;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_lean_tree_node<T>::node_type;
+	using node_pointer                     = node_type*;
+	using const_node_pointer               = const node_type*;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_lean_tree_iterator<tree_type, false>;
+	using const_iterator                   = ab_lean_tree_iterator<tree_type, true>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+
+	// construct/copy/destroy:
+
+	explicit ab_lean_tree(const Allocator& alloc = Allocator())
+		: ab_lean_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{}
+	ab_lean_tree(const tree_type& other)
+		: ab_lean_tree_node_allocator<T, Allocator>(other.get_allocator())
+		, root(nullptr)
+	{
+		root = copy_node(other.root);
+	}
+	ab_lean_tree(tree_type&& other) noexcept
+		: ab_lean_tree_node_allocator<T, Allocator>(other.get_allocator())
+		, root(nullptr)
+	{
+		swap(other);
+	}
+	ab_lean_tree(size_type n, const_reference value, const Allocator& alloc = Allocator())
+		: ab_lean_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(n, value);
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_lean_tree(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+		: ab_lean_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(first, last);
+	}
+	ab_lean_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+		: ab_lean_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_lean_tree(void)
+	{
+		destroy_subtree(root);
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			node_pointer t = copy_node(other.root);
+			destroy_subtree(root);
+			root = t;
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		insert(size_type(0), n, value);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		insert(size_type(0), first, last);
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	// iterators:
+
+	inline iterator begin(void) noexcept
+	{
+		return iterator(root, 0);
+	}
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(root, 0);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(root, 0);
+	}
+	inline iterator end(void) noexcept
+	{
+		return iterator(root, size());
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(root, size());
+	}
+	inline const_iterator cend(void) const noexcept
+	{
+		return const_iterator(root, size());
+	}
+
+	inline reverse_iterator rbegin(void) noexcept
+	{
+		return reverse_iterator(end());
+	}
+	inline const_reverse_iterator rbegin(void) const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+	inline const_reverse_iterator crbegin(void) const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+	inline reverse_iterator rend(void) noexcept
+	{
+		return reverse_iterator(begin());
+	}
+	inline const_reverse_iterator rend(void) const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+	inline const_reverse_iterator crend(void) const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	// capacity:
+
+	inline bool empty(void) const noexcept
+	{
+		return !root;
+	}
+
+	inline size_type size(void) const noexcept
+	{
+		return size_of(root);
+	}
+
+	// element access:
+
+	inline reference operator[](size_type idx) noexcept
+	{
+		return select_node(idx)->data;
+	}
+	inline const_reference operator[](size_type idx) const noexcept
+	{
+		return select_node(idx)->data;
+	}
+
+	inline reference at(size_type idx)
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return select_node(idx)->data;
+	}
+	inline const_reference at(size_type idx) const
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return select_node(idx)->data;
+	}
+
+	inline reference front(void)
+	{
+		return leftmost(root)->data;
+	}
+	inline const_reference front(void) const
+	{
+		return leftmost(root)->data;
+	}
+
+	inline reference back(void)
+	{
+		return rightmost(root)->data;
+	}
+	inline const_reference back(void) const
+	{
+		return rightmost(root)->data;
+	}
+
+	// modifiers:
+
+	template <class... Args>
+	inline void emplace_front(Args&&... args)
+	{
+		insert_node(root, 0, this->create_node(std::forward<Args>(args)...));
+	}
+
+	template <class... Args>
+	inline void emplace_back(Args&&... args)
+	{
+		insert_node(root, size(), this->create_node(std::forward<Args>(args)...));
+	}
+
+	template <class... Args>
+	inline iterator emplace(const_iterator pos, Args&&... args)
+	{
+		return emplace(pos.get_index(), std::forward<Args>(args)...);
+	}
+	template <class... Args>
+	inline iterator emplace(size_type idx, Args&&... args)
+	{
+		insert_node(root, idx, this->create_node(std::forward<Args>(args)...));
+		return iterator(root, idx);
+	}
+
+	inline void push_front(const_reference value)
+	{
+		emplace_front(value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		emplace_front(std::move(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		emplace_back(value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		emplace_back(std::move(value));
+	}
+
+	inline void pop_front(void)
+	{
+		if (root)
+			erase_node(root, 0);
+	}
+
+	inline void pop_back(void)
+	{
+		if (root)
+			erase_node(root, root->size - 1);
+	}
+
+	inline iterator insert(const_iterator pos, const_reference value)
+	{
+		return emplace(pos.get_index(), value);
+	}
+	inline iterator insert(const_iterator pos, value_type&& value)
+	{
+		return emplace(pos.get_index(), std::move(value));
+	}
+	inline iterator insert(const_iterator pos, size_type n, const_reference value)
+	{
+		return insert(pos.get_index(), n, value);
+	}
+	template <class InputIt>
+	inline iterator insert(const_iterator pos, InputIt first, InputIt last)
+	{
+		return insert(pos.get_index(), first, last);
+	}
+	inline iterator insert(const_iterator pos, std::initializer_list<value_type> ilist)
+	{
+		return insert(pos.get_index(), ilist.begin(), ilist.end());
+	}
+	inline iterator insert(size_type idx, const_reference value)
+	{
+		return emplace(idx, value);
+	}
+	inline iterator insert(size_type idx, value_type&& value)
+	{
+		return emplace(idx, std::move(value));
+	}
+	inline iterator insert(size_type idx, size_type n, const_reference value)
+	{
+		auto create = [&]() { return this->create_node(value); };
+		insert_nodes(idx, n, create);
+		return iterator(root, idx);
+	}
+	template <class InputIt>
+	inline iterator insert(size_type idx, InputIt first, InputIt last)
+	{
+		insert_range(idx, first, last, typename std::iterator_traits<InputIt>::iterator_category());
+		return iterator(root, idx);
+	}
+	inline iterator insert(size_type idx, std::initializer_list<value_type> ilist)
+	{
+		return insert(idx, ilist.begin(), ilist.end());
+	}
+
+	inline iterator erase(const_iterator pos)
+	{
+		size_type idx = pos.get_index();
+		erase(idx);
+		return iterator(root, idx);
+	}
+	inline iterator erase(const_iterator first, const_iterator last)
+	{
+		size_type idx = first.get_index();
+		erase(idx, last.get_index() - idx);
+		return iterator(root, idx);
+	}
+	inline void erase(size_type idx)
+	{
+		if (idx < size())
+			erase_node(root, idx);
+	}
+	inline void erase(size_type idx, size_type n)
+	{
+		size_type count = size();
+		if (idx >= count)
+			return;
+		if (n > count - idx)
+			n = count - idx;
+		if (n == count)
+			clear();
+		else
+			while (n-- > 0)
+				erase_node(root, idx);
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(root, rhs.root);
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		destroy_subtree(root);
+		root = nullptr;
+	}
+
+	// operations:
+
+	inline iterator select(size_type idx) noexcept
+	{
+		return iterator(root, idx);
+	}
+	inline const_iterator select(size_type idx) const noexcept
+	{
+		return const_iterator(root, idx);
+	}
+
+	inline size_type index_of(const_iterator pos) const noexcept
+	{
+		return pos.get_index();
+	}
+
+private:
+
+	static inline size_type size_of(const_node_pointer t) noexcept
+	{
+		return t ? t->size : 0;
+	}
+
+	static inline node_pointer leftmost(node_pointer t) noexcept
+	{
+		while (t->left)
+			t = t->left;
+		return t;
+	}
+
+	static inline node_pointer rightmost(node_pointer t) noexcept
+	{
+		while (t->right)
+			t = t->right;
+		return t;
+	}
+
+	node_pointer select_node(size_type idx) const noexcept
+	{
+		node_pointer t = root;
+		while (t)
+		{
+			size_type left_size = size_of(t->left);
+			if (idx < left_size)
+				t = t->left;
+			else if (idx > left_size)
+			{
+				idx -= left_size + 1;
+				t = t->right;
+			}
+			else
+				break;
+		}
+		return t;
+	}
+
+	void destroy_subtree(node_pointer t)
+	{
+		while (t)
+		{
+			node_pointer r = t->right;
+			destroy_subtree(t->left);
+			this->destroy_node(t);
+			t = r;
+		}
+	}
+
+	node_pointer copy_node(const_node_pointer t)
+	{
+		if (!t)
+			return nullptr;
+		node_pointer p = this->create_node(t->data);
+		try
+		{
+			p->left = copy_node(t->left);
+			p->right = copy_node(t->right);
+		}
+		catch (...)
+		{
+			destroy_subtree(p);
+			throw;
+		}
+		p->size = t->size;
+		return p;
+	}
+
+	template <class InputIt>
+	void insert_range(size_type idx, InputIt first, InputIt last, std::input_iterator_tag)
+	{
+		for (; first != last; ++first, ++idx)
+			insert_node(root, idx, this->create_node(*first));
+	}
+
+	template <class ForwardIt>
+	void insert_range(size_type idx, ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+	{
+		auto create = [&]() { return this->create_node(*first++); };
+		insert_nodes(idx, static_cast<size_type>(std::distance(first, last)), create);
+	}
+
+	// builds a balanced tree if it is empty, or inserts the nodes one by one
+	template <class Creator>
+	void insert_nodes(size_type idx, size_type n, Creator& create)
+	{
+		if (!root)
+			root = build_node(n, create);
+		else
+			for (size_type i = 0; i < n; ++i)
+				insert_node(root, idx + i, create());
+	}
+
+	template <class Creator>
+	node_pointer build_node(size_type n, Creator& create)
+	{
+		if (n == 0)
+			return nullptr;
+		node_pointer l = build_node((n - 1) / 2, create);
+		node_pointer t;
+		try
+		{
+			t = create();
+		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			throw;
+		}
+		t->left = l;
+		try
+		{
+			t->right = build_node(n - 1 - (n - 1) / 2, create);
+		}
+		catch (...)
+		{
+			destroy_subtree(t);
+			throw;
+		}
+		t->size = n;
+		return t;
+	}
+
+	void insert_node(node_pointer& t, size_type idx, node_pointer n) noexcept
+	{
+		if (!t)
+		{
+			t = n;
+			return;
+		}
+		++t->size;
+		size_type left_size = size_of(t->left);
+		if (idx <= left_size)
+			insert_node(t->left, idx, n);
+		else
+			insert_node(t->right, idx - left_size - 1, n);
+		rebalance_node(t, idx > left_size);
+	}
+
+	void erase_node(node_pointer& t, size_type idx)
+	{
+		size_type left_size = size_of(t->left);
+		if (idx < left_size)
+		{
+			--t->size;
+			erase_node(t->left, idx);
+			rebalance_node(t, true);
+		}
+		else if (idx > left_size)
+		{
+			--t->size;
+			erase_node(t->right, idx - left_size - 1);
+			rebalance_node(t, false);
+		}
+		else
+		{
+			node_pointer n = t;
+			if (!t->left)
+				t = t->right;
+			else if (!t->right)
+				t = t->left;
+			else
+			{
+				// replaces t by its neighbour in the larger subtree
+				bool flag = t->left->size > t->right->size;
+				node_pointer m = flag ? extract_last(t->left) : extract_first(t->right);
+				m->left = t->left;
+				m->right = t->right;
+				m->size = t->size - 1;
+				t = m;
+				rebalance_node(t, flag);
+			}
+			this->destroy_node(n);
+		}
+	}
+
+	// unlinks the first node of subtree t and returns it
+	node_pointer extract_first(node_pointer& t) noexcept
+	{
+		if (!t->left)
+		{
+			node_pointer m = t;
+			t = t->right;
+			return m;
+		}
+		--t->size;
+		node_pointer m = extract_first(t->left);
+		rebalance_node(t, true);
+		return m;
+	}
+
+	// unlinks the last node of subtree t and returns it
+	node_pointer extract_last(node_pointer& t) noexcept
+	{
+		if (!t->right)
+		{
+			node_pointer m = t;
+			t = t->left;
+			return m;
+		}
+		--t->size;
+		node_pointer m = extract_last(t->right);
+		rebalance_node(t, false);
+		return m;
+	}
+
+	static inline void left_rotate(node_pointer& t) noexcept
+	{
+		node_pointer r = t->right;
+		t->right = r->left;
+		r->left = t;
+		r->size = t->size;
+		t->size = size_of(t->left) + size_of(t->right) + 1;
+		t = r;
+	}
+
+	static inline void right_rotate(node_pointer& t) noexcept
+	{
+		node_pointer l = t->left;
+		t->left = l->right;
+		l->right = t;
+		l->size = t->size;
+		t->size = size_of(t->left) + size_of(t->right) + 1;
+		t = l;
+	}
+
+	// restores the balance of t after its right subtree grew if flag is
+	// true, or its left subtree grew otherwise
+	static void rebalance_node(node_pointer& t, bool flag) noexcept
+	{
+		if (flag)
+		{
+			if (t->right)
+			{
+				size_type left_size = size_of(t->left);
+				// case 1: size(T.left) < size(T.right.left)
+				if (t->right->left && left_size < t->right->left->size)
+				{
+					right_rotate(t->right);
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, true);
+				}
+				// case 2. size(T.left) < size(T.right.right)
+				else if (t->right->right && left_size < t->right->right->size)
+				{
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t, true);
+				}
+			}
+		}
+		else
+		{
+			if (t->left)
+			{
+				size_type right_size = size_of(t->right);
+				// case 3. size(T.right) < size(T.left.right)
+				if (t->left->right && right_size < t->left->right->size)
+				{
+					left_rotate(t->left);
+					right_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+				// case 4. size(T.right) < size(T.left.left)
+				else if (t->left->left && right_size < t->left->left->size)
+				{
+					right_rotate(t);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+			}
+		}
+	}
+
+private:
+	node_pointer root;
+};
+
+#endif
@@ -0,0 +1,1265 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_MONOID_TREE_H__
+#define __RULER_AB_MONOID_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <utility>
+#include <limits>
+#include "ab_tree.h"
+
+// A monoid maps each element to a value, and combines the values of adjacent
+// ranges by an associative operation whose identity is identity().
+
+// Class template ab_tree_sum
+template <class T>
+struct ab_tree_sum
+{
+	using value_type = T;
+
+	inline value_type identity(void) const
+	{
+		return value_type();
+	}
+
+	inline value_type lift(const T& x) const
+	{
+		return x;
+	}
+
+	inline value_type combine(const value_type& a, const value_type& b) const
+	{
+		return a + b;
+	}
+};
+
+// Class template ab_tree_min
+template <class T>
+struct ab_tree_min
+{
+	using value_type = T;
+
+	inline value_type identity(void) const
+	{
+		return std::numeric_limits<T>::max();
+	}
+
+	inline value_type lift(const T& x) const
+	{
+		return x;
+	}
+
+	inline value_type combine(const value_type& a, const value_type& b) const
+	{
+		return b < a ? b : a;
+	}
+};
+
+// Class template ab_tree_max
+template <class T>
+struct ab_tree_max
+{
+	using value_type = T;
+
+	inline value_type identity(void) const
+	{
+		return std::numeric_limits<T>::lowest();
+	}
+
+	inline value_type lift(const T& x) const
+	{
+		return x;
+	}
+
+	inline value_type combine(const value_type& a, const value_type& b) const
+	{
+		return a < b ? b : a;
+	}
+};
+
+
+// An action updates a range of elements lazily. It applies a tag to an
+// element by apply(tag, x), to the sum of n elements by apply(tag, sum, n),
+// and merges a tag into an earlier one by compose(first, second).
+
+// Struct ab_tree_no_action
+// The default action, which disables range updates.
+struct ab_tree_no_action
+{};
+
+// Class template ab_tree_add
+// Adds the tag to each element of a range.
+template <class Monoid>
+struct ab_tree_add;
+
+template <class T>
+struct ab_tree_add<ab_tree_sum<T>>
+{
+	using value_type = T;
+
+	inline void apply(const value_type& tag, T& x) const
+	{
+		x += tag;
+	}
+
+	inline T apply(const value_type& tag, const T& sum, size_t n) const
+	{
+		return sum + tag * static_cast<T>(n);
+	}
+
+	inline value_type compose(const value_type& first, const value_type& second) const
+	{
+		return first + second;
+	}
+};
+
+template <class T>
+struct ab_tree_add<ab_tree_min<T>>
+{
+	using value_type = T;
+
+	inline void apply(const value_type& tag, T& x) const
+	{
+		x += tag;
+	}
+
+	inline T apply(const value_type& tag, const T& sum, size_t) const
+	{
+		return sum + tag;
+	}
+
+	inline value_type compose(const value_type& first, const value_type& second) const
+	{
+		return first + second;
+	}
+};
+
+template <class T>
+struct ab_tree_add<ab_tree_max<T>> : ab_tree_add<ab_tree_min<T>>
+{};
+
+// Class template ab_tree_assign
+// Assigns the tag to each element of a range.
+template <class Monoid>
+struct ab_tree_assign;
+
+template <class T>
+struct ab_tree_assign<ab_tree_sum<T>>
+{
+	using value_type = T;
+
+	inline void apply(const value_type& tag, T& x) const
+	{
+		x = tag;
+	}
+
+	inline T apply(const value_type& tag, const T&, size_t n) const
+	{
+		return tag * static_cast<T>(n);
+	}
+
+	inline value_type compose(const value_type&, const value_type& second) const
+	{
+		return second;
+	}
+};
+
+template <class T>
+struct ab_tree_assign<ab_tree_min<T>>
+{
+	using value_type = T;
+
+	inline void apply(const value_type& tag, T& x) const
+	{
+		x = tag;
+	}
+
+	inline T apply(const value_type& tag, const T&, size_t) const
+	{
+		return tag;
+	}
+
+	inline value_type compose(const value_type&, const value_type& second) const
+	{
+		return second;
+	}
+};
+
+template <class T>
+struct ab_tree_assign<ab_tree_max<T>> : ab_tree_assign<ab_tree_min<T>>
+{};
+
+
+// Class template ab_monoid_tree_tag
+// The pending tag of a node, which is already applied to the node itself but
+// not yet to its children.
+template <class Action>
+struct ab_monoid_tree_tag
+{
+	using value_type = typename Action::value_type;
+
+	value_type                 tag;
+	bool                       tagged;
+};
+
+template <>
+struct ab_monoid_tree_tag<ab_tree_no_action>
+{
+	using value_type = ab_tree_no_action;
+};
+
+
+// Class template ab_monoid_tree_node
+template <class T, class V, class Action>
+struct ab_monoid_tree_node : ab_monoid_tree_tag<Action>
+{
+	using node_type            = ab_monoid_tree_node<T, V, Action>;
+	using node_pointer         = node_type*;
+	using const_node_pointer   = const node_type*;
+	using node_reference       = node_type&;
+	using const_node_reference = const node_type&;
+
+	node_pointer               left;
+	node_pointer               right;
+	size_t                     size;
+	V                          sum;
+	T                          data;
+};
+
+
+// Class template ab_monoid_tree_iterator
+// The iterator keeps the path from the root to the current node, since the
+// nodes have no parent, and pushes pending tags down as it descends.
+template <class Tree>
+class ab_monoid_tree_iterator
+{
+public:
+	// types:
+
+	using value_type        = typename Tree::value_type;
+	using pointer           = typename Tree::const_pointer;
+	using reference         = typename Tree::const_reference;
+	using size_type         = typename Tree::size_type;
+	using difference_type   = typename Tree::difference_type;
+	using node_type         = typename Tree::node_type;
+	using node_pointer      = typename Tree::node_pointer;
+
+	using iterator_type     = ab_monoid_tree_iterator<Tree>;
+	using iterator_category = std::bidirectional_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_monoid_tree_iterator(void) noexcept
+		: tree(nullptr)
+		, root(nullptr)
+		, depth(0)
+	{}
+	// points to the first node if first is true, or past the last node otherwise
+	ab_monoid_tree_iterator(const Tree* tree, const node_pointer t, bool first)
+		: tree(tree)
+		, root(t)
+		, depth(0)
+	{
+		if (first && t)
+			push_left(t);
+	}
+	ab_monoid_tree_iterator(const ab_monoid_tree_iterator<Tree>& other) noexcept
+		: tree(other.tree)
+		, root(other.root)
+		, depth(other.depth)
+	{
+		for (size_t i = 0; i < depth; ++i)
+			path[i] = other.path[i];
+	}
+
+	inline ab_monoid_tree_iterator<Tree>& operator=(const ab_monoid_tree_iterator<Tree>& other) noexcept
+	{
+		if (this != &other)
+		{
+			tree = other.tree;
+			root = other.root;
+			depth = other.depth;
+			for (size_t i = 0; i < depth; ++i)
+				path[i] = other.path[i];
+		}
+		return *this;
+	}
+
+	// ab_monoid_tree_iterator operations:
+
+	inline node_pointer get_pointer(void) const noexcept
+	{
+		return depth ? path[depth - 1] : nullptr;
+	}
+
+	// increment / decrement
+
+	ab_monoid_tree_iterator<Tree>& operator++(void)
+	{
+		node_pointer t = path[depth - 1];
+		if (t->right)
+			push_left(t->right);
+		else
+		{
+			// climbs until the node is a left child
+			do
+				t = path[--depth];
+			while (depth && path[depth - 1]->right == t);
+		}
+		return *this;
+	}
+
+	ab_monoid_tree_iterator<Tree>& operator--(void)
+	{
+		if (!depth)
+			push_right(root);
+		else
+		{
+			node_pointer t = path[depth - 1];
+			if (t->left)
+				push_right(t->left);
+			else
+			{
+				// climbs until the node is a right child
+				do
+					t = path[--depth];
+				while (depth && path[depth - 1]->left == t);
+			}
+		}
+		return *this;
+	}
+
+	inline ab_monoid_tree_iterator<Tree> operator++(int)
+	{
+		ab_monoid_tree_iterator<Tree> tmp(*this);
+		++*this;
+		return tmp;
+	}
+
+	inline ab_monoid_tree_iterator<Tree> operator--(int)
+	{
+		ab_monoid_tree_iterator<Tree> tmp(*this);
+		--*this;
+		return tmp;
+	}
+
+	// element access:
+
+	inline reference operator*(void) const noexcept
+	{
+		return path[depth - 1]->data;
+	}
+
+	inline pointer operator->(void) const noexcept
+	{
+		return std::addressof(path[depth - 1]->data);
+	}
+
+	// relational operators:
+
+	inline bool operator==(const ab_monoid_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return get_pointer() == rhs.get_pointer();
+	}
+
+	inline bool operator!=(const ab_monoid_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return get_pointer() != rhs.get_pointer();
+	}
+
+private:
+
+	inline void push_left(node_pointer t)
+	{
+		for (; t; t = t->left)
+		{
+			path[depth++] = t;
+			tree->push_node(t);
+		}
+	}
+
+	inline void push_right(node_pointer t)
+	{
+		for (; t; t = t->right)
+		{
+			path[depth++] = t;
+			tree->push_node(t);
+		}
+	}
+
+private:
+	const Tree*  tree;
+	node_pointer root;
+	size_t       depth;
+	node_pointer path[ab_tree_max_depth];
+};
+
+
+// Class template ab_monoid_tree_node_allocator
+template <class T, class V, class Action, class Allocator>
+class ab_monoid_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_monoid_tree_node<T, V, Action>::node_type;
+	using tag_base_type        = ab_monoid_tree_tag<Action>;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_monoid_tree_node_allocator(void)
+		: allocator()
+	{}
+	explicit ab_monoid_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+	{}
+	explicit ab_monoid_tree_node_allocator(Allocator&& alloc)
+		: allocator(std::forward<Allocator>(alloc))
+	{}
+
+	~ab_monoid_tree_node_allocator(void)
+	{}
+
+	// ab_monoid_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		return node_traits_type::max_size(node_alloc);
+	}
+
+protected:
+
+	// creates a leaf whose sum is still to be computed
+	template <class ...Args>
+	inline node_pointer create_node(Args&&... args)
+	{
+		node_pointer p = node_traits_type::allocate(node_alloc, 1);
+		try
+		{
+			traits_type::construct(allocator, std::addressof(p->data), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits_type::deallocate(node_alloc, p, 1);
+			throw;
+		}
+		::new (static_cast<void*>(std::addressof(p->sum))) V();
+		::new (static_cast<void*>(static_cast<tag_base_type*>(p))) tag_base_type();
+		p->left = nullptr;
+		p->right = nullptr;
+		p->size = 1;
+		return p;
+	}
+
+	inline void destroy_node(const node_pointer p)
+	{
+		static_cast<tag_base_type*>(p)->~tag_base_type();
+		p->sum.~V();
+		traits_type::destroy(allocator, std::addressof(p->data));
+		node_traits_type::deallocate(node_alloc, p, 1);
+	}
+
+	inline void swap_allocator(ab_monoid_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_monoid_tree
+// An ab-tree whose nodes also keep the monoid sum of their subtrees, so the
+// sum of any range, and the first prefix whose sum satisfies a monotone
+// predicate, are found in O(log n). The elements are only modified through
+// the tree, so that the sums stay up to date. With an action, a range of
+// elements is updated in O(log n) by tagging the subtrees that cover it, and
+// the tags are pushed down to the elements when they are reached, even by
+// const member functions and iterators.
+template <class T, class Monoid = ab_tree_sum<T>, class Action = ab_tree_no_action, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_monoid_tree : public ab_monoid_tree_node_allocator<T, typename Monoid::value_type, Action, Allocator>
+{
+	friend class ab_monoid_tree_iterator<ab_monoid_tree<T, Monoid, Action, Allocator>>;
+
+public:
+	// types:
+
+	using tree_type                        = ab_monoid_tree<T, Monoid, Action, Allocator>;
+	using monoid_type                      = Monoid;
+	using action_type                      = Action;
+	using sum_type                         = typename Monoid::value_type;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_monoid_tree_node<T, sum_type, Action>::node_type;
+	using tag_base_type                    = ab_monoid_tree_tag<Action>;
+	using tag_type                         = typename tag_base_type::value_type;
+	using node_pointer                     = node_type*;
+	using const_node_pointer               = const node_type*;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_monoid_tree_iterator<tree_type>;
+	using const_iterator                   = ab_monoid_tree_iterator<tree_type>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+
+	static constexpr bool has_action       = !std::is_same<Action, ab_tree_no_action>::value;
+
+	// construct/copy/destroy:
+
+	explicit ab_monoid_tree(const Monoid& monoid = Monoid(), const Allocator& alloc = Allocator())
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(alloc)
+		, monoid(monoid)
+		, root(nullptr)
+	{}
+	ab_monoid_tree(const tree_type& other)
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(other.get_allocator())
+		, monoid(other.monoid)
+		, action(other.action)
+		, root(copy_node(other.root))
+	{}
+	ab_monoid_tree(tree_type&& other) noexcept
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(other.get_allocator())
+		, monoid(other.monoid)
+		, action(other.action)
+		, root(nullptr)
+	{
+		swap(other);
+	}
+	ab_monoid_tree(size_type n, const_reference value, const Monoid& monoid = Monoid(), const Allocator& alloc = Allocator())
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(alloc)
+		, monoid(monoid)
+		, root(nullptr)
+	{
+		assign(n, value);
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_monoid_tree(InputIt first, InputIt last, const Monoid& monoid = Monoid(), const Allocator& alloc = Allocator())
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(alloc)
+		, monoid(monoid)
+		, root(nullptr)
+	{
+		assign(first, last);
+	}
+	ab_monoid_tree(std::initializer_list<T> ilist, const Monoid& monoid = Monoid(), const Allocator& alloc = Allocator())
+		: ab_monoid_tree_node_allocator<T, sum_type, Action, Allocator>(alloc)
+		, monoid(monoid)
+		, root(nullptr)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_monoid_tree(void)
+	{
+		clear();
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			monoid = other.monoid;
+			action = other.action;
+			root = copy_node(other.root);
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		auto create = [&]() { return this->create_node(value); };
+		root = build_node(n, create);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		assign_range(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	inline monoid_type get_monoid(void) const
+	{
+		return monoid;
+	}
+
+	inline action_type get_action(void) const
+	{
+		return action;
+	}
+
+	// iterators:
+
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(this, root, true);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(this, root, true);
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(this, root, false);
+	}
+	inline const_iterator cend(void) const noexcept
+	{
+		return const_iterator(this, root, false);
+	}
+
+	inline const_reverse_iterator rbegin(void) const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+	inline const_reverse_iterator crbegin(void) const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+	inline const_reverse_iterator rend(void) const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+	inline const_reverse_iterator crend(void) const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	// capacity:
+
+	inline bool empty(void) const noexcept
+	{
+		return !root;
+	}
+
+	inline size_type size(void) const noexcept
+	{
+		return root ? root->size : 0;
+	}
+
+	// element access:
+
+	inline const_reference operator[](size_type idx) const noexcept
+	{
+		return select_node(idx)->data;
+	}
+
+	inline const_reference at(size_type idx) const
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return select_node(idx)->data;
+	}
+
+	inline const_reference front(void) const
+	{
+		return *begin();
+	}
+
+	inline const_reference back(void) const
+	{
+		return *rbegin();
+	}
+
+	// modifiers:
+
+	template <class... Args>
+	inline void emplace(size_type idx, Args&&... args)
+	{
+		node_pointer n = this->create_node(std::forward<Args>(args)...);
+		update_node(n);
+		insert_node(root, idx, n);
+	}
+
+	template <class... Args>
+	inline void emplace_front(Args&&... args)
+	{
+		emplace(0, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline void emplace_back(Args&&... args)
+	{
+		emplace(size(), std::forward<Args>(args)...);
+	}
+
+	inline void insert(size_type idx, const_reference value)
+	{
+		emplace(idx, value);
+	}
+	inline void insert(size_type idx, value_type&& value)
+	{
+		emplace(idx, std::move(value));
+	}
+
+	inline void push_front(const_reference value)
+	{
+		emplace(0, value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		emplace(0, std::move(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		emplace(size(), value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		emplace(size(), std::move(value));
+	}
+
+	inline void pop_front(void)
+	{
+		erase(0);
+	}
+
+	inline void pop_back(void)
+	{
+		erase(size() - 1);
+	}
+
+	inline void erase(size_type idx)
+	{
+		if (idx < size())
+			erase_node(root, idx);
+	}
+
+	// replaces the element at index idx
+	inline void set(size_type idx, const_reference value)
+	{
+		modify(idx, [&](reference x) { x = value; });
+	}
+	inline void set(size_type idx, value_type&& value)
+	{
+		modify(idx, [&](reference x) { x = std::move(value); });
+	}
+
+	// calls f on the element at index idx and updates the sums above it
+	template <class Function>
+	inline void modify(size_type idx, Function f)
+	{
+		if (idx < size())
+			modify_node(root, idx, f);
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(root, rhs.root);
+			std::swap(monoid, rhs.monoid);
+			std::swap(action, rhs.action);
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		destroy_subtree(root);
+		root = nullptr;
+	}
+
+	// applies tag to each element in [first, last) in O(log n)
+	inline void update(size_type first, size_type last, const tag_type& tag)
+	{
+		static_assert(has_action, "The ab_monoid_tree has no action.");
+		size_type count = size();
+		if (last > count)
+			last = count;
+		if (first < last)
+			tag_range(root, first, last, tag);
+	}
+
+	// operations:
+
+	// returns the sum of all elements
+	inline sum_type reduce(void) const
+	{
+		return root ? root->sum : monoid.identity();
+	}
+
+	// returns the sum of the elements in [first, last)
+	inline sum_type reduce(size_type first, size_type last) const
+	{
+		size_type count = size();
+		if (last > count)
+			last = count;
+		if (first >= last)
+			return monoid.identity();
+		return reduce_node(root, first, last);
+	}
+
+	// returns the first index i for which pred(sum of [0, i]) is true, or
+	// size() if there is none, pred must be false up to some index and true
+	// from there on
+	template <class Predicate>
+	size_type find_prefix(Predicate pred) const
+	{
+		sum_type acc = monoid.identity();
+		size_type idx = 0;
+		node_pointer t = root;
+		while (t)
+		{
+			push_node(t);
+			sum_type left_sum = t->left ? monoid.combine(acc, t->left->sum) : acc;
+			if (pred(left_sum))
+				t = t->left;
+			else
+			{
+				sum_type sum = monoid.combine(left_sum, monoid.lift(t->data));
+				idx += size_of(t->left);
+				if (pred(sum))
+					return idx;
+				acc = std::move(sum);
+				++idx;
+				t = t->right;
+			}
+		}
+		return idx;
+	}
+
+private:
+
+	static inline size_type size_of(const node_pointer t) noexcept
+	{
+		return t ? t->size : 0;
+	}
+
+	// applies the pending tag of t to its children
+	inline void push_node(node_pointer t) const
+	{
+		push_node(t, std::integral_constant<bool, has_action>());
+	}
+
+	inline void push_node(node_pointer, std::false_type) const noexcept
+	{}
+
+	inline void push_node(node_pointer t, std::true_type) const
+	{
+		if (t->tagged)
+		{
+			if (t->left)
+				apply_tag(t->left, t->tag);
+			if (t->right)
+				apply_tag(t->right, t->tag);
+			t->tagged = false;
+		}
+	}
+
+	// applies tag to node t, and leaves it pending for the children of t
+	void apply_tag(node_pointer t, const tag_type& tag) const
+	{
+		action.apply(tag, t->data);
+		t->sum = action.apply(tag, t->sum, t->size);
+		if (t->left || t->right)
+		{
+			if (t->tagged)
+				t->tag = action.compose(t->tag, tag);
+			else
+			{
+				t->tag = tag;
+				t->tagged = true;
+			}
+		}
+	}
+
+	// applies tag to [first, last) within subtree t, the range is not empty
+	void tag_range(node_pointer t, size_type first, size_type last, const tag_type& tag)
+	{
+		if (first == 0 && last == t->size)
+		{
+			apply_tag(t, tag);
+			return;
+		}
+		push_node(t);
+		size_type left_size = size_of(t->left);
+		if (first < left_size)
+			tag_range(t->left, first, last < left_size ? last : left_size, tag);
+		if (first <= left_size && left_size < last)
+			action.apply(tag, t->data);
+		if (last > left_size + 1)
+			tag_range(t->right, first > left_size + 1 ? first - left_size - 1 : 0, last - left_size - 1, tag);
+		update_node(t);
+	}
+
+	// recomputes the size and the sum of t from its children
+	inline void update_node(node_pointer t) const
+	{
+		sum_type sum = monoid.lift(t->data);
+		if (t->left)
+			sum = monoid.combine(t->left->sum, sum);
+		if (t->right)
+			sum = monoid.combine(sum, t->right->sum);
+		t->sum = std::move(sum);
+		t->size = size_of(t->left) + size_of(t->right) + 1;
+	}
+
+	void destroy_subtree(node_pointer t)
+	{
+		while (t)
+		{
+			node_pointer r = t->right;
+			destroy_subtree(t->left);
+			this->destroy_node(t);
+			t = r;
+		}
+	}
+
+	node_pointer copy_node(const node_pointer t)
+	{
+		if (!t)
+			return nullptr;
+		node_pointer n = this->create_node(t->data);
+		try
+		{
+			n->left = copy_node(t->left);
+			n->right = copy_node(t->right);
+		}
+		catch (...)
+		{
+			destroy_subtree(n);
+			throw;
+		}
+		n->size = t->size;
+		n->sum = t->sum;
+		static_cast<tag_base_type&>(*n) = static_cast<const tag_base_type&>(*t);
+		return n;
+	}
+
+	template <class InputIt>
+	void assign_range(InputIt first, InputIt last, std::input_iterator_tag)
+	{
+		for (; first != last; ++first)
+			emplace_back(*first);
+	}
+
+	template <class ForwardIt>
+	void assign_range(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+	{
+		auto create = [&]() { return this->create_node(*first++); };
+		root = build_node(static_cast<size_type>(std::distance(first, last)), create);
+	}
+
+	// builds a perfectly balanced subtree of n nodes, created in order by create()
+	template <class Creator>
+	node_pointer build_node(size_type n, Creator& create)
+	{
+		if (n == 0)
+			return nullptr;
+		node_pointer l = build_node((n - 1) / 2, create);
+		node_pointer t;
+		try
+		{
+			t = create();
+		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			throw;
+		}
+		t->left = l;
+		try
+		{
+			t->right = build_node(n - 1 - (n - 1) / 2, create);
+		}
+		catch (...)
+		{
+			destroy_subtree(t);
+			throw;
+		}
+		update_node(t);
+		return t;
+	}
+
+	node_pointer select_node(size_type idx) const noexcept
+	{
+		node_pointer t = root;
+		while (t)
+		{
+			push_node(t);
+			size_type left_size = size_of(t->left);
+			if (idx < left_size)
+				t = t->left;
+			else if (idx > left_size)
+			{
+				idx -= left_size + 1;
+				t = t->right;
+			}
+			else
+				break;
+		}
+		return t;
+	}
+
+	// returns the sum of [first, last) within subtree t, the range is not empty
+	sum_type reduce_node(node_pointer t, size_type first, size_type last) const
+	{
+		if (first == 0 && last == t->size)
+			return t->sum;
+		push_node(t);
+		size_type left_size = size_of(t->left);
+		if (last <= left_size)
+			return reduce_node(t->left, first, last);
+		if (first > left_size)
+			return reduce_node(t->right, first - left_size - 1, last - left_size - 1);
+		sum_type sum = monoid.lift(t->data);
+		if (first < left_size)
+			sum = monoid.combine(reduce_node(t->left, first, left_size), sum);
+		if (last > left_size + 1)
+			sum = monoid.combine(sum, reduce_node(t->right, 0, last - left_size - 1));
+		return sum;
+	}
+
+	template <class Function>
+	void modify_node(node_pointer t, size_type idx, Function& f)
+	{
+		push_node(t);
+		size_type left_size = size_of(t->left);
+		if (idx < left_size)
+			modify_node(t->left, idx, f);
+		else if (idx > left_size)
+			modify_node(t->right, idx - left_size - 1, f);
+		else
+			f(t->data);
+		update_node(t);
+	}
+
+	void insert_node(node_pointer& t, size_type idx, node_pointer n)
+	{
+		if (!t)
+		{
+			t = n;
+			return;
+		}
+		push_node(t);
+		size_type left_size = size_of(t->left);
+		if (idx <= left_size)
+			insert_node(t->left, idx, n);
+		else
+			insert_node(t->right, idx - left_size - 1, n);
+		update_node(t);
+		rebalance_node(t, idx > left_size);
+	}
+
+	void erase_node(node_pointer& t, size_type idx)
+	{
+		push_node(t);
+		size_type left_size = size_of(t->left);
+		if (idx < left_size)
+		{
+			erase_node(t->left, idx);
+			update_node(t);
+			rebalance_node(t, true);
+		}
+		else if (idx > left_size)
+		{
+			erase_node(t->right, idx - left_size - 1);
+			update_node(t);
+			rebalance_node(t, false);
+		}
+		else
+		{
+			node_pointer n = t;
+			if (!t->left)
+				t = t->right;
+			else if (!t->right)
+				t = t->left;
+			else
+			{
+				// replaces t by its neighbour in the larger subtree
+				bool flag = t->left->size > t->right->size;
+				node_pointer m = flag ? extract_last(t->left) : extract_first(t->right);
+				m->left = t->left;
+				m->right = t->right;
+				update_node(m);
+				t = m;
+				rebalance_node(t, flag);
+			}
+			this->destroy_node(n);
+		}
+	}
+
+	// unlinks the first node of subtree t and returns it
+	node_pointer extract_first(node_pointer& t)
+	{
+		push_node(t);
+		if (!t->left)
+		{
+			node_pointer m = t;
+			t = t->right;
+			return m;
+		}
+		node_pointer m = extract_first(t->left);
+		update_node(t);
+		rebalance_node(t, true);
+		return m;
+	}
+
+	// unlinks the last node of subtree t and returns it
+	node_pointer extract_last(node_pointer& t)
+	{
+		push_node(t);
+		if (!t->right)
+		{
+			node_pointer m = t;
+			t = t->left;
+			return m;
+		}
+		node_pointer m = extract_last(t->right);
+		update_node(t);
+		rebalance_node(t, false);
+		return m;
+	}
+
+	// the tags of t and its new root are pushed before a rotation
+
+	void left_rotate(node_pointer& t)
+	{
+		node_pointer r = t->right;
+		push_node(t);
+		push_node(r);
+		t->right = r->left;
+		r->left = t;
+		update_node(t);
+		update_node(r);
+		t = r;
+	}
+
+	void right_rotate(node_pointer& t)
+	{
+		node_pointer l = t->left;
+		push_node(t);
+		push_node(l);
+		t->left = l->right;
+		l->right = t;
+		update_node(t);
+		update_node(l);
+		t = l;
+	}
+
+	// restores the balance of t after its right subtree grew if flag is
+	// true, or its left subtree grew otherwise
+	void rebalance_node(node_pointer& t, bool flag)
+	{
+		if (flag)
+		{
+			if (t->right)
+			{
+				size_type left_size = size_of(t->left);
+				// case 1: size(T.left) < size(T.right.left)
+				if (t->right->left && left_size < t->right->left->size)
+				{
+					right_rotate(t->right);
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, true);
+				}
+				// case 2. size(T.left) < size(T.right.right)
+				else if (t->right->right && left_size < t->right->right->size)
+				{
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t, true);
+				}
+			}
+		}
+		else
+		{
+			if (t->left)
+			{
+				size_type right_size = size_of(t->right);
+				// case 3. size(T.right) < size(T.left.right)
+				if (t->left->right && right_size < t->left->right->size)
+				{
+					left_rotate(t->left);
+					right_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+				// case 4. size(T.right) < size(T.left.left)
+				else if (t->left->left && right_size < t->left->left->size)
+				{
+					right_rotate(t);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+			}
+		}
+	}
+
+private:
+	monoid_type  monoid;
+	action_type  action;
+	node_pointer root;
+};
+
+#endif
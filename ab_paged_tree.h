@@ -0,0 +1,792 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+#pragma once
+
+#ifndef __RULER_AB_PAGED_TREE_H__
+#define __RULER_AB_PAGED_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstring>
+#include "ab_tree.h"
+#include "ab_monoid_tree.h"
+
+// Struct ab_paged_statistics
+struct ab_paged_statistics
+{
+	size_t pages;  // the number of pages holding elements
+	size_t hits;   // the page accesses served by the cache
+	size_t reads;  // the pages read from the file
+	size_t writes; // the dirty pages written back to the file
+};
+
+
+// Struct ab_paged_frame
+// A page held in the cache, with the bits of the clock replacement.
+struct ab_paged_frame
+{
+	uint64_t       page;
+	unsigned       pins;       // the frame cannot be evicted while pinned
+	bool           used;
+	bool           dirty;
+	bool           referenced;
+	unsigned char* data;
+};
+
+
+// Class template ab_paged_cache
+// The file of pages and a bounded cache of them. A page missing from the
+// cache replaces the first unpinned frame the clock hand finds that was not
+// referenced since the hand last passed it, and a replaced dirty page is
+// written back to the file.
+template <size_t PageSize>
+class ab_paged_cache
+{
+public:
+	// types:
+
+	using size_type  = size_t;
+	using frame_type = ab_paged_frame;
+
+	// construct/copy/destroy:
+
+	ab_paged_cache(const std::string& filename, size_type capacity)
+		: file(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc)
+		, buffer(new page_type[capacity])
+		, frames(capacity)
+		, hand(0)
+		, next_page(0)
+		, stats{}
+	{
+		if (!file)
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+		for (size_type i = 0; i < capacity; ++i)
+			frames[i] = frame_type{ 0, 0, false, false, false, buffer[i].data };
+	}
+	ab_paged_cache(const ab_paged_cache&) = delete;
+
+	ab_paged_cache& operator=(const ab_paged_cache&) = delete;
+
+	// ab_paged_cache operations:
+
+	// returns the frame of a page, reading it from the file if it is missing
+	frame_type* fetch(uint64_t page)
+	{
+		auto itr = table.find(page);
+		if (itr != table.end())
+		{
+			++stats.hits;
+			frame_type* f = &frames[itr->second];
+			f->referenced = true;
+			return f;
+		}
+		frame_type* f = replace(page);
+		read_page(*f);
+		++stats.reads;
+		return f;
+	}
+
+	// returns the frame of a new page, whose contents are undefined
+	frame_type* allocate(void)
+	{
+		uint64_t page;
+		if (free_pages.empty())
+			page = next_page;
+		else
+			page = free_pages.back();
+		frame_type* f = replace(page);
+		if (free_pages.empty())
+			++next_page;
+		else
+			free_pages.pop_back();
+		f->dirty = true;
+		return f;
+	}
+
+	// drops a page without writing it back, its place in the file is reused
+	void release(uint64_t page)
+	{
+		auto itr = table.find(page);
+		if (itr != table.end())
+		{
+			frames[itr->second].used = false;
+			frames[itr->second].dirty = false;
+			table.erase(itr);
+		}
+		free_pages.push_back(page);
+	}
+
+	// drops all pages
+	void clear(void) noexcept
+	{
+		for (frame_type& f : frames)
+		{
+			f.used = false;
+			f.dirty = false;
+		}
+		table.clear();
+		free_pages.clear();
+		next_page = 0;
+	}
+
+	// writes all dirty pages back to the file
+	void flush(void)
+	{
+		for (frame_type& f : frames)
+		{
+			if (f.used && f.dirty)
+				write_back(f);
+		}
+		if (!file.flush())
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+	}
+
+	inline ab_paged_statistics statistics(size_type pages) const noexcept
+	{
+		ab_paged_statistics s = stats;
+		s.pages = pages;
+		return s;
+	}
+
+	inline void reset_statistics(void) noexcept
+	{
+		stats = ab_paged_statistics{};
+	}
+
+private:
+
+	struct page_type
+	{
+		alignas(std::max_align_t) unsigned char data[PageSize];
+	};
+
+	// takes a frame for page by the clock, writing back the page it held
+	frame_type* replace(uint64_t page)
+	{
+		for (;;)
+		{
+			frame_type& f = frames[hand];
+			hand = hand + 1 == frames.size() ? 0 : hand + 1;
+			if (!f.used || (f.pins == 0 && !f.referenced))
+			{
+				if (f.used)
+				{
+					if (f.dirty)
+						write_back(f);
+					table.erase(f.page);
+				}
+				table.emplace(page, static_cast<size_type>(&f - frames.data()));
+				f.page = page;
+				f.used = true;
+				f.dirty = false;
+				f.referenced = true;
+				return &f;
+			}
+			if (f.pins == 0)
+				f.referenced = false;
+		}
+	}
+
+	void write_back(frame_type& f)
+	{
+		file.seekp(static_cast<std::streamoff>(f.page * PageSize));
+		if (!file.write(reinterpret_cast<const char*>(f.data), PageSize))
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+		f.dirty = false;
+		++stats.writes;
+	}
+
+	void read_page(frame_type& f)
+	{
+		file.seekg(static_cast<std::streamoff>(f.page * PageSize));
+		if (!file.read(reinterpret_cast<char*>(f.data), PageSize))
+		{
+			// the frame must not keep a page that was not read
+			table.erase(f.page);
+			f.used = false;
+			file.clear();
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+		}
+	}
+
+private:
+	std::fstream                            file;
+	std::unique_ptr<page_type[]>            buffer;
+	std::vector<frame_type>                 frames;
+	std::unordered_map<uint64_t, size_type> table;
+	std::vector<uint64_t>                   free_pages;
+	size_type                               hand;
+	uint64_t                                next_page;
+	ab_paged_statistics                     stats;
+};
+
+
+// Struct ab_paged_entry
+// A page in the directory of an ab_paged_tree.
+struct ab_paged_entry
+{
+	uint64_t page;
+	size_t   size;
+};
+
+
+// Struct ab_paged_size_sum
+struct ab_paged_size_sum
+{
+	using value_type = size_t;
+
+	inline value_type identity(void) const
+	{
+		return 0;
+	}
+
+	inline value_type lift(const ab_paged_entry& x) const
+	{
+		return x.size;
+	}
+
+	inline value_type combine(const value_type& a, const value_type& b) const
+	{
+		return a + b;
+	}
+};
+
+
+// Class template ab_paged_tree_iterator
+// Elements are returned by value, since the page holding one may be evicted
+// by the next access to the tree.
+template <class Tree>
+class ab_paged_tree_iterator
+{
+public:
+	// types:
+
+	using value_type        = typename Tree::value_type;
+	using pointer           = const value_type*;
+	using reference         = value_type;
+	using size_type         = typename Tree::size_type;
+	using difference_type   = typename Tree::difference_type;
+
+	using iterator_type     = ab_paged_tree_iterator<Tree>;
+	using iterator_category = std::input_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_paged_tree_iterator(void) noexcept
+		: tree(nullptr)
+		, entry(0)
+		, offset(0)
+		, index(0)
+		, page(0)
+		, count(0)
+	{}
+	ab_paged_tree_iterator(const Tree* t, size_type n, size_type off, size_type idx)
+		: tree(t)
+		, entry(n)
+		, offset(off)
+		, index(idx)
+	{
+		load_entry();
+	}
+
+	// ab_paged_tree_iterator operations:
+
+	inline size_type get_index(void) const noexcept
+	{
+		return index;
+	}
+
+	inline value_type operator*(void) const
+	{
+		return tree->read_element(page, offset);
+	}
+
+	// increment / decrement
+
+	ab_paged_tree_iterator<Tree>& operator++(void)
+	{
+		++index;
+		if (++offset == count && entry + 1 < tree->directory.size())
+		{
+			++entry;
+			offset = 0;
+			load_entry();
+		}
+		return *this;
+	}
+
+	ab_paged_tree_iterator<Tree>& operator--(void)
+	{
+		--index;
+		if (offset == 0)
+		{
+			--entry;
+			load_entry();
+			offset = count;
+		}
+		--offset;
+		return *this;
+	}
+
+	inline ab_paged_tree_iterator<Tree> operator++(int)
+	{
+		iterator_type itr(*this);
+		this->operator++();
+		return itr;
+	}
+
+	inline ab_paged_tree_iterator<Tree> operator--(int)
+	{
+		iterator_type itr(*this);
+		this->operator--();
+		return itr;
+	}
+
+	// relational operators:
+
+	inline bool operator==(const ab_paged_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return index == rhs.index;
+	}
+
+	inline bool operator!=(const ab_paged_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return index != rhs.index;
+	}
+
+private:
+	inline void load_entry(void)
+	{
+		const ab_paged_entry& e = tree->directory[entry];
+		page = e.page;
+		count = e.size;
+	}
+
+private:
+	const Tree* tree;
+	size_type   entry;  // the position of the page in the directory
+	size_type   offset; // the position of the element in the page
+	size_type   index;
+	uint64_t    page;
+	size_type   count;
+};
+
+
+// Class template ab_paged_tree
+// An array larger than memory, whose elements are kept in runs of
+// consecutive indices on fixed-size pages of a file. Only a bounded cache
+// of the pages stays in memory, together with the directory of the pages,
+// an ab_monoid_tree summing their sizes, which takes a few dozen bytes per
+// page. Selecting an element descends the directory and touches a single
+// page. A full page is split in halves, except at the end where appending
+// starts a new page, and a page that drops below a quarter is merged with
+// or refilled from a neighbour. Elements must be trivially copyable.
+template <class T, size_t PageSize = 4096, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_paged_tree
+{
+	static_assert(std::is_trivially_copyable<T>::value, "The elements of a paged AB-Tree must be trivially copyable.");
+	static_assert(PageSize >= 4 * sizeof(T), "A page of a paged AB-Tree must hold at least four elements.");
+
+public:
+	// types:
+
+	using value_type      = T;
+	using allocator_type  = Allocator;
+	using reference       = value_type;
+	using const_reference = value_type;
+	using size_type       = size_t;
+	using difference_type = ptrdiff_t;
+
+	using tree_type       = ab_paged_tree<T, PageSize, Allocator>;
+	using iterator        = ab_paged_tree_iterator<tree_type>;
+	using const_iterator  = iterator;
+
+	// the number of elements per page
+	static constexpr size_type page_capacity = PageSize / sizeof(T);
+	// the cache holds 4 MiB of pages by default
+	static constexpr size_type default_cache_pages = (size_type(4) << 20) / PageSize;
+
+	// construct/copy/destroy:
+
+	// creates the tree in a new file, or truncates the file if it exists
+	explicit ab_paged_tree(const std::string& filename, size_type cache_pages = default_cache_pages, const Allocator& alloc = Allocator())
+		: cache(filename, cache_pages < 4 ? 4 : cache_pages)
+		, directory(ab_paged_size_sum(), typename directory_type::allocator_type(alloc))
+	{
+		directory.push_back(ab_paged_entry{ cache.allocate()->page, 0 });
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_paged_tree(const std::string& filename, InputIt first, InputIt last, size_type cache_pages = default_cache_pages, const Allocator& alloc = Allocator())
+		: ab_paged_tree(filename, cache_pages, alloc)
+	{
+		for (; first != last; ++first)
+			push_back(*first);
+	}
+	ab_paged_tree(const ab_paged_tree&) = delete;
+
+	ab_paged_tree& operator=(const ab_paged_tree&) = delete;
+
+	inline allocator_type get_allocator(void) const
+	{
+		return allocator_type(directory.get_allocator());
+	}
+
+	// iterators:
+
+	inline const_iterator begin(void) const
+	{
+		return const_iterator(this, 0, 0, 0);
+	}
+	inline const_iterator cbegin(void) const
+	{
+		return begin();
+	}
+	inline const_iterator end(void) const
+	{
+		size_type n = directory.size() - 1;
+		return const_iterator(this, n, directory[n].size, size());
+	}
+	inline const_iterator cend(void) const
+	{
+		return end();
+	}
+
+	// capacity:
+
+	inline bool empty(void) const
+	{
+		return size() == 0;
+	}
+
+	inline size_type size(void) const
+	{
+		return directory.reduce();
+	}
+
+	inline size_type page_count(void) const
+	{
+		return directory.size();
+	}
+
+	// element access:
+
+	inline value_type operator[](size_type idx) const
+	{
+		size_type pos;
+		size_type n = locate(idx, false, pos);
+		return read_element(directory[n].page, pos);
+	}
+	inline value_type at(size_type idx) const
+	{
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return operator[](idx);
+	}
+
+	inline value_type front(void) const
+	{
+		return operator[](0);
+	}
+	inline value_type back(void) const
+	{
+		return operator[](size() - 1);
+	}
+
+	// modifiers:
+
+	// calls f to modify the element at index idx in its page
+	template <class Function>
+	void modify(size_type idx, Function f)
+	{
+		size_type pos;
+		size_type n = locate(idx, false, pos);
+		frame_type* p = cache.fetch(directory[n].page);
+		f(elements(p)[pos]);
+		p->dirty = true;
+	}
+
+	inline void set(size_type idx, const value_type& value)
+	{
+		modify(idx, [&](value_type& x) { x = value; });
+	}
+
+	// inserts an element before index idx, or at the end if idx is beyond it
+	iterator insert(size_type idx, const value_type& value)
+	{
+		size_type count = size();
+		if (idx > count)
+			idx = count;
+		size_type pos;
+		size_type n = locate(idx, true, pos);
+		frame_type* p = cache.fetch(directory[n].page);
+		count = directory[n].size;
+		if (count == page_capacity)
+		{
+			page_pin pin(p);
+			frame_type* q = cache.allocate();
+			if (pos == count && n + 1 == directory.size())
+			{
+				// appending starts a new page
+				directory.push_back(ab_paged_entry{ q->page, 0 });
+				count = 0;
+				pos = 0;
+			}
+			else
+			{
+				// splits the page in halves
+				size_type half = count / 2;
+				std::memcpy(elements(q), elements(p) + half, (count - half) * sizeof(value_type));
+				directory.insert(n + 1, ab_paged_entry{ q->page, count - half });
+				directory.modify(n, [&](ab_paged_entry& e) { e.size = half; });
+				p->dirty = true;
+				if (pos <= half)
+				{
+					q = p;
+					count = half;
+					--n;
+				}
+				else
+				{
+					pos -= half;
+					count -= half;
+				}
+			}
+			p = q;
+			++n;
+		}
+		value_type* data = elements(p);
+		std::memmove(data + pos + 1, data + pos, (count - pos) * sizeof(value_type));
+		data[pos] = value;
+		p->dirty = true;
+		directory.modify(n, [](ab_paged_entry& e) { ++e.size; });
+		return iterator(this, n, pos, idx);
+	}
+	inline iterator insert(const_iterator pos, const value_type& value)
+	{
+		return insert(pos.get_index(), value);
+	}
+
+	inline void push_front(const value_type& value)
+	{
+		insert(0, value);
+	}
+	inline void push_back(const value_type& value)
+	{
+		insert(size(), value);
+	}
+
+	// erases the element at index idx, or nothing if there is none
+	iterator erase(size_type idx)
+	{
+		if (idx >= size())
+			return end();
+		size_type pos;
+		size_type n = locate(idx, false, pos);
+		frame_type* p = cache.fetch(directory[n].page);
+		size_type count = directory[n].size;
+		value_type* data = elements(p);
+		std::memmove(data + pos, data + pos + 1, (count - pos - 1) * sizeof(value_type));
+		p->dirty = true;
+		directory.modify(n, [](ab_paged_entry& e) { --e.size; });
+		if (--count < page_capacity / 4 && directory.size() > 1)
+			rebalance_page(n, p);
+		return select(idx);
+	}
+	inline iterator erase(const_iterator pos)
+	{
+		return erase(pos.get_index());
+	}
+
+	inline void pop_front(void)
+	{
+		erase(0);
+	}
+	inline void pop_back(void)
+	{
+		if (!empty())
+			erase(size() - 1);
+	}
+
+	void clear(void)
+	{
+		cache.clear();
+		directory.clear();
+		directory.push_back(ab_paged_entry{ cache.allocate()->page, 0 });
+	}
+
+	// operations:
+
+	inline const_iterator select(size_type idx) const
+	{
+		if (idx >= size())
+			return end();
+		size_type pos;
+		size_type n = locate(idx, false, pos);
+		return const_iterator(this, n, pos, idx);
+	}
+
+	// writes all modified pages back to the file
+	inline void flush(void)
+	{
+		cache.flush();
+	}
+
+	// reports the pages in use and the work of the cache
+	inline ab_paged_statistics statistics(void) const noexcept
+	{
+		return cache.statistics(directory.size());
+	}
+
+	inline void reset_statistics(void) noexcept
+	{
+		cache.reset_statistics();
+	}
+
+private:
+
+	friend class ab_paged_tree_iterator<tree_type>;
+
+	using frame_type     = typename ab_paged_cache<PageSize>::frame_type;
+	using directory_type = ab_monoid_tree<ab_paged_entry, ab_paged_size_sum, ab_tree_no_action,
+		typename std::allocator_traits<Allocator>::template rebind_alloc<ab_paged_entry>>;
+
+	// keeps a frame in the cache while another page is fetched
+	class page_pin
+	{
+	public:
+		explicit page_pin(frame_type* p) noexcept
+			: frame(p)
+		{
+			++frame->pins;
+		}
+		page_pin(const page_pin&) = delete;
+		~page_pin(void)
+		{
+			--frame->pins;
+		}
+
+		page_pin& operator=(const page_pin&) = delete;
+
+	private:
+		frame_type* frame;
+	};
+
+	static inline value_type* elements(frame_type* p) noexcept
+	{
+		return reinterpret_cast<value_type*>(p->data);
+	}
+
+	inline value_type read_element(uint64_t page, size_type pos) const
+	{
+		return elements(cache.fetch(page))[pos];
+	}
+
+	// finds the page holding index idx and the index pos in it, where an
+	// index between two pages is at the end of the first if inserting
+	inline size_type locate(size_type idx, bool inserting, size_type& pos) const
+	{
+		size_type before = 0;
+		size_type n = directory.find_prefix([&](size_type sum)
+		{
+			bool found = inserting ? sum >= idx : sum > idx;
+			if (!found && before < sum)
+				before = sum;
+			return found;
+		});
+		pos = idx - before;
+		return n;
+	}
+
+	// merges page n of frame p with a neighbour if both fit on one page, and
+	// otherwise moves elements from the neighbour until they hold as many
+	void rebalance_page(size_type n, frame_type* p)
+	{
+		page_pin pin(p);
+		if (n + 1 == directory.size())
+		{
+			// the last page leans on its previous one
+			frame_type* q = cache.fetch(directory[n - 1].page);
+			page_pin q_pin(q);
+			move_elements(n - 1, q, p);
+		}
+		else
+			move_elements(n, p, cache.fetch(directory[n + 1].page));
+	}
+
+	// evens out the neighbouring pages n and n + 1 held by frames a and b,
+	// and drops page n + 1 if everything fits on page n
+	void move_elements(size_type n, frame_type* a, frame_type* b)
+	{
+		size_type a_count = directory[n].size;
+		size_type b_count = directory[n + 1].size;
+		size_type total = a_count + b_count;
+		value_type* a_data = elements(a);
+		value_type* b_data = elements(b);
+		if (total <= page_capacity)
+		{
+			std::memcpy(a_data + a_count, b_data, b_count * sizeof(value_type));
+			a->dirty = true;
+			directory.modify(n, [&](ab_paged_entry& e) { e.size = total; });
+			directory.erase(n + 1);
+			cache.release(b->page);
+			return;
+		}
+		size_type half = total / 2;
+		if (a_count < half)
+		{
+			size_type k = half - a_count;
+			std::memcpy(a_data + a_count, b_data, k * sizeof(value_type));
+			std::memmove(b_data, b_data + k, (b_count - k) * sizeof(value_type));
+		}
+		else
+		{
+			size_type k = a_count - half;
+			std::memmove(b_data + k, b_data, b_count * sizeof(value_type));
+			std::memcpy(b_data, a_data + half, k * sizeof(value_type));
+		}
+		a->dirty = true;
+		b->dirty = true;
+		directory.modify(n, [&](ab_paged_entry& e) { e.size = half; });
+		directory.modify(n + 1, [&](ab_paged_entry& e) { e.size = total - half; });
+	}
+
+private:
+	mutable ab_paged_cache<PageSize> cache;
+	directory_type                   directory;
+};
+
+#endif
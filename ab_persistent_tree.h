@@ -0,0 +1,912 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_PERSISTENT_TREE_H__
+#define __RULER_AB_PERSISTENT_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <utility>
+#include <atomic>
+#include "ab_tree.h"
+
+
+// Class template ab_persistent_tree_node
+template <class T>
+struct ab_persistent_tree_node
+{
+	using node_type            = ab_persistent_tree_node<T>;
+	using node_pointer         = node_type*;
+	using const_node_pointer   = const node_type*;
+	using node_reference       = node_type&;
+	using const_node_reference = const node_type&;
+
+	node_pointer               left;
+	node_pointer               right;
+	size_t                     size;
+	std::atomic<size_t>        refs;
+	T                          data;
+};
+
+
+// Class template ab_persistent_tree_iterator
+// Nodes have no parent since they may be shared by several trees, so the
+// iterator keeps the path from the root to the current node.
+template <class Tree>
+class ab_persistent_tree_iterator
+{
+public:
+	// types:
+
+	using value_type        = typename Tree::value_type;
+	using pointer           = typename Tree::const_pointer;
+	using reference         = typename Tree::const_reference;
+	using size_type         = typename Tree::size_type;
+	using difference_type   = typename Tree::difference_type;
+	using node_type         = typename Tree::node_type;
+	using node_pointer      = typename Tree::node_pointer;
+
+	using iterator_type     = ab_persistent_tree_iterator<Tree>;
+	using iterator_category = std::bidirectional_iterator_tag;
+
+	// construct/copy/destroy:
+
+	ab_persistent_tree_iterator(void) noexcept
+		: root(nullptr)
+		, depth(0)
+	{}
+	// points to the first node if first is true, or past the last node otherwise
+	ab_persistent_tree_iterator(const node_pointer t, bool first) noexcept
+		: root(t)
+		, depth(0)
+	{
+		if (first && t)
+			push_left(t);
+	}
+	ab_persistent_tree_iterator(const ab_persistent_tree_iterator<Tree>& other) noexcept
+		: root(other.root)
+		, depth(other.depth)
+	{
+		for (size_t i = 0; i < depth; ++i)
+			path[i] = other.path[i];
+	}
+
+	inline ab_persistent_tree_iterator<Tree>& operator=(const ab_persistent_tree_iterator<Tree>& other) noexcept
+	{
+		if (this != &other)
+		{
+			root = other.root;
+			depth = other.depth;
+			for (size_t i = 0; i < depth; ++i)
+				path[i] = other.path[i];
+		}
+		return *this;
+	}
+
+	// ab_persistent_tree_iterator operations:
+
+	inline node_pointer get_pointer(void) const noexcept
+	{
+		return depth ? path[depth - 1] : nullptr;
+	}
+
+	// increment / decrement
+
+	ab_persistent_tree_iterator<Tree>& operator++(void) noexcept
+	{
+		node_pointer t = path[depth - 1];
+		if (t->right)
+			push_left(t->right);
+		else
+		{
+			// climbs until the node is a left child
+			do
+				t = path[--depth];
+			while (depth && path[depth - 1]->right == t);
+		}
+		return *this;
+	}
+
+	ab_persistent_tree_iterator<Tree>& operator--(void) noexcept
+	{
+		if (!depth)
+			push_right(root);
+		else
+		{
+			node_pointer t = path[depth - 1];
+			if (t->left)
+				push_right(t->left);
+			else
+			{
+				// climbs until the node is a right child
+				do
+					t = path[--depth];
+				while (depth && path[depth - 1]->left == t);
+			}
+		}
+		return *this;
+	}
+
+	inline ab_persistent_tree_iterator<Tree> operator++(int) noexcept
+	{
+		ab_persistent_tree_iterator<Tree> tmp(*this);
+		++*this;
+		return tmp;
+	}
+
+	inline ab_persistent_tree_iterator<Tree> operator--(int) noexcept
+	{
+		ab_persistent_tree_iterator<Tree> tmp(*this);
+		--*this;
+		return tmp;
+	}
+
+	// element access:
+
+	inline reference operator*(void) const noexcept
+	{
+		return path[depth - 1]->data;
+	}
+
+	inline pointer operator->(void) const noexcept
+	{
+		return std::addressof(path[depth - 1]->data);
+	}
+
+	// relational operators:
+
+	inline bool operator==(const ab_persistent_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return get_pointer() == rhs.get_pointer();
+	}
+
+	inline bool operator!=(const ab_persistent_tree_iterator<Tree>& rhs) const noexcept
+	{
+		return get_pointer() != rhs.get_pointer();
+	}
+
+private:
+
+	inline void push_left(node_pointer t) noexcept
+	{
+		for (; t; t = t->left)
+			path[depth++] = t;
+	}
+
+	inline void push_right(node_pointer t) noexcept
+	{
+		for (; t; t = t->right)
+			path[depth++] = t;
+	}
+
+private:
+	node_pointer root;
+	size_t       depth;
+	node_pointer path[ab_tree_max_depth];
+};
+
+
+// Class template ab_persistent_tree_node_allocator
+template <class T, class Allocator>
+class ab_persistent_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_persistent_tree_node<T>::node_type;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_persistent_tree_node_allocator(void)
+		: allocator()
+		, node_alloc()
+	{}
+	explicit ab_persistent_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+		, node_alloc(alloc)
+	{}
+	// copies share nodes, so they share the node allocator too
+	ab_persistent_tree_node_allocator(const ab_persistent_tree_node_allocator& other)
+		: allocator(other.allocator)
+		, node_alloc(other.node_alloc)
+	{}
+
+	~ab_persistent_tree_node_allocator(void)
+	{}
+
+	// ab_persistent_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		return node_traits_type::max_size(node_alloc);
+	}
+
+protected:
+
+	// creates a leaf referenced once
+	template <class ...Args>
+	inline node_pointer create_node(Args&&... args)
+	{
+		node_pointer p = node_traits_type::allocate(node_alloc, 1);
+		try
+		{
+			traits_type::construct(allocator, std::addressof(p->data), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits_type::deallocate(node_alloc, p, 1);
+			throw;
+		}
+		::new (static_cast<void*>(std::addressof(p->refs))) std::atomic<size_t>(1);
+		p->left = nullptr;
+		p->right = nullptr;
+		p->size = 1;
+		return p;
+	}
+
+	inline void destroy_node(const node_pointer p)
+	{
+		traits_type::destroy(allocator, std::addressof(p->data));
+		p->refs.~atomic();
+		node_traits_type::deallocate(node_alloc, p, 1);
+	}
+
+	inline void swap_allocator(ab_persistent_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+	inline void share_allocator(const ab_persistent_tree_node_allocator& other)
+	{
+		allocator = other.allocator;
+		node_alloc = other.node_alloc;
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_persistent_tree
+// An ab-tree whose copies share their nodes. Nodes are reference counted, and
+// a modification copies only the shared nodes on the path it walks, so a copy
+// costs O(1) and a modification O(log n). Copies may be read and released by
+// other threads while the original is modified.
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_persistent_tree : public ab_persistent_tree_node_allocator<T, Allocator>
+{
+public:
+	// types:
+
+	using tree_type                        = ab_persistent_tree<T, Allocator>;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_persistent_tree_node<T>::node_type;
+	using node_pointer                     = node_type*;
+	using const_node_pointer               = const node_type*;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_persistent_tree_iterator<tree_type>;
+	using const_iterator                   = ab_persistent_tree_iterator<tree_type>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+
+	// construct/copy/destroy:
+
+	explicit ab_persistent_tree(const Allocator& alloc = Allocator())
+		: ab_persistent_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{}
+	ab_persistent_tree(const tree_type& other) noexcept
+		: ab_persistent_tree_node_allocator<T, Allocator>(other)
+		, root(acquire_node(other.root))
+	{}
+	ab_persistent_tree(tree_type&& other) noexcept
+		: ab_persistent_tree_node_allocator<T, Allocator>(other)
+		, root(other.root)
+	{
+		other.root = nullptr;
+	}
+	ab_persistent_tree(size_type n, const_reference value, const Allocator& alloc = Allocator())
+		: ab_persistent_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(n, value);
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_persistent_tree(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+		: ab_persistent_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(first, last);
+	}
+	ab_persistent_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+		: ab_persistent_tree_node_allocator<T, Allocator>(alloc)
+		, root(nullptr)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_persistent_tree(void)
+	{
+		release_node(root);
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			node_pointer t = acquire_node(other.root);
+			release_node(root);
+			this->share_allocator(other);
+			root = t;
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		auto create = [&]() { return this->create_node(value); };
+		root = build_node(n, create);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		assign_range(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	// iterators:
+
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(root, true);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(root, true);
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(root, false);
+	}
+	inline const_iterator cend(void) const noexcept
+	{
+		return const_iterator(root, false);
+	}
+
+	inline const_reverse_iterator rbegin(void) const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+	inline const_reverse_iterator crbegin(void) const noexcept
+	{
+		return const_reverse_iterator(cend());
+	}
+	inline const_reverse_iterator rend(void) const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+	inline const_reverse_iterator crend(void) const noexcept
+	{
+		return const_reverse_iterator(cbegin());
+	}
+
+	// capacity:
+
+	inline bool empty(void) const noexcept
+	{
+		return !root;
+	}
+
+	inline size_type size(void) const noexcept
+	{
+		return root ? root->size : 0;
+	}
+
+	// element access:
+
+	// the reference is only valid until the tree is copied
+	inline reference operator[](size_type idx)
+	{
+		return unique_node(idx)->data;
+	}
+	inline const_reference operator[](size_type idx) const noexcept
+	{
+		return select_node(idx)->data;
+	}
+
+	inline reference at(size_type idx)
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return unique_node(idx)->data;
+	}
+	inline const_reference at(size_type idx) const
+	{
+		if (empty())
+			throw std::domain_error(ABT_NOT_INITIALIZED);
+		if (idx >= size())
+			throw std::out_of_range(ABT_OUT_OF_RANGE);
+		return select_node(idx)->data;
+	}
+
+	inline const_reference front(void) const
+	{
+		return *begin();
+	}
+
+	inline const_reference back(void) const
+	{
+		return *rbegin();
+	}
+
+	// modifiers:
+
+	template <class... Args>
+	inline void emplace(size_type idx, Args&&... args)
+	{
+		node_pointer n = this->create_node(std::forward<Args>(args)...);
+		try
+		{
+			insert_node(root, idx, n);
+		}
+		catch (...)
+		{
+			// n is still ours if copying a shared node threw before it was linked
+			release_node(n);
+			throw;
+		}
+	}
+
+	template <class... Args>
+	inline void emplace_front(Args&&... args)
+	{
+		emplace(0, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	inline void emplace_back(Args&&... args)
+	{
+		emplace(size(), std::forward<Args>(args)...);
+	}
+
+	inline void insert(size_type idx, const_reference value)
+	{
+		emplace(idx, value);
+	}
+	inline void insert(size_type idx, value_type&& value)
+	{
+		emplace(idx, std::move(value));
+	}
+
+	inline void push_front(const_reference value)
+	{
+		emplace(0, value);
+	}
+	inline void push_front(value_type&& value)
+	{
+		emplace(0, std::move(value));
+	}
+
+	inline void push_back(const_reference value)
+	{
+		emplace(size(), value);
+	}
+	inline void push_back(value_type&& value)
+	{
+		emplace(size(), std::move(value));
+	}
+
+	inline void pop_front(void)
+	{
+		erase(0);
+	}
+
+	inline void pop_back(void)
+	{
+		erase(size() - 1);
+	}
+
+	inline void erase(size_type idx)
+	{
+		if (idx < size())
+			erase_node(root, idx);
+	}
+
+	// replaces the element at index idx
+	inline void set(size_type idx, const_reference value)
+	{
+		unique_node(idx)->data = value;
+	}
+	inline void set(size_type idx, value_type&& value)
+	{
+		unique_node(idx)->data = std::move(value);
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(root, rhs.root);
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		release_node(root);
+		root = nullptr;
+	}
+
+	// operations:
+
+	// returns true if no other tree shares the nodes of this tree
+	inline bool unique(void) const noexcept
+	{
+		return !root || root->refs.load(std::memory_order_acquire) == 1;
+	}
+
+private:
+
+	static inline size_type size_of(const node_pointer t) noexcept
+	{
+		return t ? t->size : 0;
+	}
+
+	static inline node_pointer acquire_node(node_pointer t) noexcept
+	{
+		if (t)
+			t->refs.fetch_add(1, std::memory_order_relaxed);
+		return t;
+	}
+
+	// drops a reference to t, and destroys the nodes no longer referenced
+	void release_node(node_pointer t)
+	{
+		while (t && t->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			node_pointer r = t->right;
+			release_node(t->left);
+			this->destroy_node(t);
+			t = r;
+		}
+	}
+
+	// replaces a shared node by a copy that references the same children
+	void unshare_node(node_pointer& t)
+	{
+		if (t->refs.load(std::memory_order_acquire) == 1)
+			return;
+		node_pointer p = this->create_node(t->data);
+		p->left = acquire_node(t->left);
+		p->right = acquire_node(t->right);
+		p->size = t->size;
+		release_node(t);
+		t = p;
+	}
+
+	node_pointer select_node(size_type idx) const noexcept
+	{
+		node_pointer t = root;
+		while (t)
+		{
+			size_type left_size = size_of(t->left);
+			if (idx < left_size)
+				t = t->left;
+			else if (idx > left_size)
+			{
+				idx -= left_size + 1;
+				t = t->right;
+			}
+			else
+				break;
+		}
+		return t;
+	}
+
+	// copies the shared nodes on the path to index idx
+	node_pointer unique_node(size_type idx)
+	{
+		node_pointer* slot = &root;
+		while (*slot)
+		{
+			unshare_node(*slot);
+			node_pointer t = *slot;
+			size_type left_size = size_of(t->left);
+			if (idx < left_size)
+				slot = &t->left;
+			else if (idx > left_size)
+			{
+				idx -= left_size + 1;
+				slot = &t->right;
+			}
+			else
+				break;
+		}
+		return *slot;
+	}
+
+	template <class InputIt>
+	void assign_range(InputIt first, InputIt last, std::input_iterator_tag)
+	{
+		for (; first != last; ++first)
+			emplace_back(*first);
+	}
+
+	template <class ForwardIt>
+	void assign_range(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+	{
+		auto create = [&]() { return this->create_node(*first++); };
+		root = build_node(static_cast<size_type>(std::distance(first, last)), create);
+	}
+
+	template <class Creator>
+	node_pointer build_node(size_type n, Creator& create)
+	{
+		if (n == 0)
+			return nullptr;
+		node_pointer l = build_node((n - 1) / 2, create);
+		node_pointer t;
+		try
+		{
+			t = create();
+		}
+		catch (...)
+		{
+			release_node(l);
+			throw;
+		}
+		t->left = l;
+		try
+		{
+			t->right = build_node(n - 1 - (n - 1) / 2, create);
+		}
+		catch (...)
+		{
+			release_node(t);
+			throw;
+		}
+		t->size = n;
+		return t;
+	}
+
+	// links n at index idx, and clears n once the tree owns it
+	void insert_node(node_pointer& t, size_type idx, node_pointer& n)
+	{
+		if (!t)
+		{
+			t = n;
+			n = nullptr;
+			return;
+		}
+		unshare_node(t);
+		size_type left_size = size_of(t->left);
+		if (idx <= left_size)
+			insert_node(t->left, idx, n);
+		else
+			insert_node(t->right, idx - left_size - 1, n);
+		++t->size;
+		rebalance_node(t, idx > left_size);
+	}
+
+	void erase_node(node_pointer& t, size_type idx)
+	{
+		unshare_node(t);
+		size_type left_size = size_of(t->left);
+		if (idx < left_size)
+		{
+			erase_node(t->left, idx);
+			--t->size;
+			rebalance_node(t, true);
+		}
+		else if (idx > left_size)
+		{
+			erase_node(t->right, idx - left_size - 1);
+			--t->size;
+			rebalance_node(t, false);
+		}
+		else
+		{
+			node_pointer n = t;
+			if (!t->left)
+				t = t->right;
+			else if (!t->right)
+				t = t->left;
+			else
+			{
+				// replaces t by its neighbour in the larger subtree
+				bool flag = t->left->size > t->right->size;
+				node_pointer m = flag ? extract_last(t->left) : extract_first(t->right);
+				m->left = t->left;
+				m->right = t->right;
+				m->size = t->size - 1;
+				t = m;
+				rebalance_node(t, flag);
+			}
+			// the children of n are now referenced by t
+			n->left = nullptr;
+			n->right = nullptr;
+			this->destroy_node(n);
+		}
+	}
+
+	// unlinks the first node of subtree t and returns it
+	node_pointer extract_first(node_pointer& t)
+	{
+		unshare_node(t);
+		if (!t->left)
+		{
+			node_pointer m = t;
+			t = t->right;
+			return m;
+		}
+		node_pointer m = extract_first(t->left);
+		--t->size;
+		rebalance_node(t, true);
+		return m;
+	}
+
+	// unlinks the last node of subtree t and returns it
+	node_pointer extract_last(node_pointer& t)
+	{
+		unshare_node(t);
+		if (!t->right)
+		{
+			node_pointer m = t;
+			t = t->left;
+			return m;
+		}
+		node_pointer m = extract_last(t->right);
+		--t->size;
+		rebalance_node(t, false);
+		return m;
+	}
+
+	// t and its new root must be unshared before a rotation
+
+	void left_rotate(node_pointer& t)
+	{
+		unshare_node(t->right);
+		node_pointer r = t->right;
+		t->right = r->left;
+		r->left = t;
+		r->size = t->size;
+		t->size = size_of(t->left) + size_of(t->right) + 1;
+		t = r;
+	}
+
+	void right_rotate(node_pointer& t)
+	{
+		unshare_node(t->left);
+		node_pointer l = t->left;
+		t->left = l->right;
+		l->right = t;
+		l->size = t->size;
+		t->size = size_of(t->left) + size_of(t->right) + 1;
+		t = l;
+	}
+
+	// restores the balance of t after its right subtree grew if flag is
+	// true, or its left subtree grew otherwise
+	void rebalance_node(node_pointer& t, bool flag)
+	{
+		if (flag)
+		{
+			if (t->right)
+			{
+				size_type left_size = size_of(t->left);
+				// case 1: size(T.left) < size(T.right.left)
+				if (t->right->left && left_size < t->right->left->size)
+				{
+					unshare_node(t->right);
+					right_rotate(t->right);
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, true);
+				}
+				// case 2. size(T.left) < size(T.right.right)
+				else if (t->right->right && left_size < t->right->right->size)
+				{
+					left_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t, true);
+				}
+			}
+		}
+		else
+		{
+			if (t->left)
+			{
+				size_type right_size = size_of(t->right);
+				// case 3. size(T.right) < size(T.left.right)
+				if (t->left->right && right_size < t->left->right->size)
+				{
+					unshare_node(t->left);
+					left_rotate(t->left);
+					right_rotate(t);
+					rebalance_node(t->left, false);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+				// case 4. size(T.right) < size(T.left.left)
+				else if (t->left->left && right_size < t->left->left->size)
+				{
+					right_rotate(t);
+					rebalance_node(t->right, true);
+					rebalance_node(t, false);
+				}
+			}
+		}
+	}
+
+private:
+	node_pointer root;
+};
+
+#endif
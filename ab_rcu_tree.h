@@ -0,0 +1,216 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_RCU_TREE_H__
+#define __RULER_AB_RCU_TREE_H__
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include "ab_persistent_tree.h"
+
+// Struct ab_rcu_slot
+// The epoch announced by a pinned reader, or 0 while the slot is free. Each
+// slot has a cache line of its own, so readers do not contend.
+struct alignas(64) ab_rcu_slot
+{
+	std::atomic<uint64_t> epoch{ 0 };
+};
+
+
+// Class template ab_rcu_snapshot
+// A pinned version of an ab_rcu_tree. It reads like a constant
+// ab_persistent_tree, and its nodes are not reclaimed until it is destroyed.
+template <class Tree>
+class ab_rcu_snapshot
+{
+public:
+	// types:
+
+	using tree_type = Tree;
+
+	// construct/copy/destroy:
+
+	ab_rcu_snapshot(ab_rcu_slot* slot, const tree_type* version) noexcept
+		: slot(slot)
+		, version(version)
+	{}
+	ab_rcu_snapshot(const ab_rcu_snapshot&) = delete;
+	ab_rcu_snapshot(ab_rcu_snapshot&& other) noexcept
+		: slot(other.slot)
+		, version(other.version)
+	{
+		other.slot = nullptr;
+	}
+
+	~ab_rcu_snapshot(void)
+	{
+		if (slot)
+			slot->epoch.store(0, std::memory_order_release);
+	}
+
+	ab_rcu_snapshot& operator=(const ab_rcu_snapshot&) = delete;
+
+	// ab_rcu_snapshot operations:
+
+	inline const tree_type& operator*(void) const noexcept
+	{
+		return *version;
+	}
+
+	inline const tree_type* operator->(void) const noexcept
+	{
+		return version;
+	}
+
+private:
+	ab_rcu_slot*     slot;
+	const tree_type* version;
+};
+
+
+// Class template ab_rcu_tree
+// An ab_persistent_tree with one writer and any number of readers that never
+// block. The writer modifies a working tree, whose nodes shared with a
+// published version are copied rather than modified, and publish makes an
+// O(1) copy of it the current version. A reader pins the current version by
+// announcing the epoch in a free slot, and then reads it without locks or
+// reference counting. A replaced version is retired with the epoch of its
+// replacement, and released once every pinned reader announced a later
+// epoch, which frees the nodes that no newer version shares.
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_rcu_tree
+{
+public:
+	// types:
+
+	using tree_type          = ab_persistent_tree<T, Allocator>;
+	using snapshot_type      = ab_rcu_snapshot<tree_type>;
+	using allocator_type     = typename tree_type::allocator_type;
+	using value_type         = typename tree_type::value_type;
+	using size_type          = typename tree_type::size_type;
+
+	static constexpr size_type default_max_readers = 128;
+
+	// construct/copy/destroy:
+
+	explicit ab_rcu_tree(size_type max_readers = default_max_readers, const Allocator& alloc = Allocator())
+		: working(alloc)
+		, slots(new ab_rcu_slot[max_readers > 0 ? max_readers : 1])
+		, slot_count(max_readers > 0 ? max_readers : 1)
+		, current(nullptr)
+		, epoch(1)
+	{
+		current.store(new tree_type(working), std::memory_order_release);
+	}
+	ab_rcu_tree(const ab_rcu_tree&) = delete;
+
+	// no snapshot may outlive the tree
+	~ab_rcu_tree(void)
+	{
+		for (auto& r : retired)
+			delete r.first;
+		delete current.load(std::memory_order_acquire);
+	}
+
+	ab_rcu_tree& operator=(const ab_rcu_tree&) = delete;
+
+	// ab_rcu_tree operations:
+
+	// the tree modified by the writer, which readers see once it is published
+	inline tree_type& writer(void) noexcept
+	{
+		return working;
+	}
+
+	// makes the working tree the version seen by new snapshots, and releases
+	// the versions no reader has pinned
+	void publish(void)
+	{
+		std::unique_ptr<tree_type> version(new tree_type(working));
+		retired.reserve(retired.size() + 1);
+		const tree_type* old = current.exchange(version.release(), std::memory_order_seq_cst);
+		retired.emplace_back(old, epoch.fetch_add(1, std::memory_order_seq_cst));
+		reclaim();
+	}
+
+	// releases the retired versions that no reader has pinned, and returns
+	// how many are still pinned
+	size_type reclaim(void)
+	{
+		uint64_t oldest = UINT64_MAX;
+		for (size_type i = 0; i < slot_count; ++i)
+		{
+			uint64_t e = slots[i].epoch.load(std::memory_order_seq_cst);
+			if (e != 0 && e < oldest)
+				oldest = e;
+		}
+		size_type kept = 0;
+		for (auto& r : retired)
+		{
+			if (r.second < oldest)
+				delete r.first;
+			else
+				retired[kept++] = r;
+		}
+		retired.resize(kept);
+		return kept;
+	}
+
+	// pins the current version in at most max_readers steps, and throws
+	// std::length_error if all slots are taken
+	snapshot_type snapshot(void) const
+	{
+		size_type start = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+		for (size_type i = 0; i < slot_count; ++i)
+		{
+			ab_rcu_slot& slot = slots[(start + i) % slot_count];
+			uint64_t free = 0;
+			if (slot.epoch.load(std::memory_order_relaxed) == 0
+				&& slot.epoch.compare_exchange_strong(free, epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst))
+				return snapshot_type(&slot, current.load(std::memory_order_seq_cst));
+		}
+		throw std::length_error(ABT_TOO_MANY_READERS);
+	}
+
+private:
+	tree_type                                          working;
+	std::unique_ptr<ab_rcu_slot[]>                     slots;
+	size_type                                          slot_count;
+	std::atomic<const tree_type*>                      current;
+	std::atomic<uint64_t>                              epoch;
+	std::vector<std::pair<const tree_type*, uint64_t>> retired;
+};
+
+#endif
@@ -31,11 +31,23 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __RULER_AB_TREE_H__
 
 #include <memory>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <type_traits>
 #include <stdexcept>
 #include <iterator>
 #include <functional>
 #include <utility>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <exception>
 #include "define.h"
+#include "ab_tree_pool.h"
 
 #ifndef DEFAULT_ALLOCATOR
 #define DEFAULT_ALLOCATOR(T) std::allocator<T>
@@ -48,10 +60,44 @@ static constexpr ab_tree_node_state ab_tree_state_left    =  0x12;
 static constexpr ab_tree_node_state ab_tree_state_right   =  0x13;
 static constexpr ab_tree_node_state ab_tree_state_sibling =  0x04;
 
+// An ABT of n nodes is at most about 1.44 * log2(n) high, so a path of 96
+// nodes is enough for any size_t.
+static constexpr size_t ab_tree_max_depth = 96;
+
+
+template <class T>
+struct ab_tree_node;
+
+
+// Class template ab_tree_node_links
+// The links of a node, which are all that the header of an ab-tree holds. The
+// tree is walked through pointers to the links, and only the nodes that hold
+// an element are converted to ab_tree_node to reach it.
+template <class T>
+struct ab_tree_node_links
+{
+	using link_pointer         = ab_tree_node_links<T>*;
+
+	link_pointer               parent;
+	link_pointer               left;
+	link_pointer               right;
+	size_t                     size;
+
+	// the element of a node, which must not be the header
+	inline T& value(void) noexcept
+	{
+		return static_cast<ab_tree_node<T>*>(this)->data;
+	}
+	inline const T& value(void) const noexcept
+	{
+		return static_cast<const ab_tree_node<T>*>(this)->data;
+	}
+};
+
 
 // Class template ab_tree_node
 template <class T>
-struct ab_tree_node
+struct ab_tree_node : ab_tree_node_links<T>
 {
 	using node_type            = ab_tree_node<T>;
 	using node_pointer         = node_type*;
@@ -59,10 +105,6 @@ struct ab_tree_node
 	using node_reference       = node_type&;
 	using const_node_reference = const node_type&;
 
-	node_pointer               parent;
-	node_pointer               left;
-	node_pointer               right;
-	size_t                     size;
 	T                          data;
 };
 
@@ -110,7 +152,7 @@ public:
 	using node_pointer      = typename ab_tree_type_traits<Tree, IsConst>::node_pointer;
 
 	using iterator_type     = ab_tree_iterator<Tree, IsConst>;
-	using iterator_category = std::bidirectional_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
 
 	// construct/copy/destroy:
 
@@ -161,9 +203,22 @@ public:
 		return node->size;
 	}
 
+	// returns the index of the element by summing the sizes of left subtrees
+	size_type get_index(void) const noexcept
+	{
+		// the header is the only node without size
+		if (node->size == 0)
+			return node->parent ? node->parent->size : 0;
+		size_type k = size_of(node->left);
+		for (node_pointer t = node, p = node->parent; p->size != 0; t = p, p = p->parent)
+			if (t == p->right)
+				k += size_of(p->left) + 1;
+		return k;
+	}
+
 	inline reference operator*(void) const noexcept
 	{
-		return node->data;
+		return node->value();
 	}
 
 	inline pointer operator->(void) const noexcept
@@ -171,6 +226,11 @@ public:
 		return &(operator*());
 	}
 
+	inline reference operator[](difference_type n) const noexcept
+	{
+		return *(*this + n);
+	}
+
 	// increment / decrement
 
 	ab_tree_iterator<Tree, IsConst>& operator++(void) noexcept
@@ -197,7 +257,8 @@ public:
 
 	ab_tree_iterator<Tree, IsConst>& operator--(void) noexcept
 	{
-		if (!node->parent || node->parent->parent == node)
+		// the header is the only node without size
+		if (node->size == 0)
 			node = node->right;
 		else if (node->left)
 		{
@@ -233,6 +294,36 @@ public:
 		return itr;
 	}
 
+	// random access
+
+	inline ab_tree_iterator<Tree, IsConst>& operator+=(difference_type n) noexcept
+	{
+		node = advance_node(node, n);
+		return *this;
+	}
+
+	inline ab_tree_iterator<Tree, IsConst>& operator-=(difference_type n) noexcept
+	{
+		node = advance_node(node, -n);
+		return *this;
+	}
+
+	inline ab_tree_iterator<Tree, IsConst> operator+(difference_type n) const noexcept
+	{
+		return iterator_type(advance_node(node, n));
+	}
+
+	inline ab_tree_iterator<Tree, IsConst> operator-(difference_type n) const noexcept
+	{
+		return iterator_type(advance_node(node, -n));
+	}
+
+	template <bool is_const>
+	inline difference_type operator-(const ab_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return static_cast<difference_type>(get_index()) - static_cast<difference_type>(rhs.get_index());
+	}
+
 	// relational operators:
 
 	template <bool is_const>
@@ -247,10 +338,90 @@ public:
 		return node != rhs.get_pointer();
 	}
 
+	template <bool is_const>
+	inline bool operator<(const ab_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return get_index() < rhs.get_index();
+	}
+
+	template <bool is_const>
+	inline bool operator>(const ab_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return get_index() > rhs.get_index();
+	}
+
+	template <bool is_const>
+	inline bool operator<=(const ab_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return get_index() <= rhs.get_index();
+	}
+
+	template <bool is_const>
+	inline bool operator>=(const ab_tree_iterator<Tree, is_const>& rhs) const noexcept
+	{
+		return get_index() >= rhs.get_index();
+	}
+
 private:
+
+	static inline size_type size_of(const node_pointer t) noexcept
+	{
+		return t ? t->size : 0;
+	}
+
+	// moves n elements from node t, climbing only until the target is in the subtree
+	static node_pointer advance_node(node_pointer t, difference_type n) noexcept
+	{
+		difference_type k;
+		if (n == 0)
+			return t;
+		if (t->size == 0)
+		{
+			// moves backward from the header
+			if (!t->parent)
+				return t;
+			t = t->parent;
+			k = static_cast<difference_type>(t->size) + n;
+		}
+		else
+		{
+			k = static_cast<difference_type>(size_of(t->left)) + n;
+			while ((k < 0 || k >= static_cast<difference_type>(t->size)) && t->parent->size != 0)
+			{
+				if (t == t->parent->right)
+					k += static_cast<difference_type>(size_of(t->parent->left)) + 1;
+				t = t->parent;
+			}
+			// moves to the header
+			if (k < 0 || k >= static_cast<difference_type>(t->size))
+				return t->parent;
+		}
+		// descends to the target
+		while (true)
+		{
+			difference_type left_size = static_cast<difference_type>(size_of(t->left));
+			if (left_size < k)
+			{
+				k -= (left_size + 1);
+				t = t->right;
+			}
+			else if (k < left_size)
+				t = t->left;
+			else
+				return t;
+		}
+	}
+
 	node_pointer node;
 };
 
+template <class Tree, bool IsConst>
+inline ab_tree_iterator<Tree, IsConst> operator+(typename ab_tree_iterator<Tree, IsConst>::difference_type n,
+	const ab_tree_iterator<Tree, IsConst>& itr) noexcept
+{
+	return itr + n;
+}
+
 
 // Class template ab_tree_primitive_iterator
 template <class Tree, bool IsConst>
@@ -337,7 +508,7 @@ public:
 
 	inline reference operator*(void) const noexcept
 	{
-		return node->data;
+		return node->value();
 	}
 
 	inline pointer operator->(void) const noexcept
@@ -433,215 +604,789 @@ private:
 };
 
 
-// Class template ab_tree_node_allocator
-template <class T, class Allocator>
-class ab_tree_node_allocator
+// Class template ab_tree_slice
+template <class Tree, bool IsConst>
+class ab_tree_slice
 {
 public:
 	// types:
 
-	using tree_traits_type     = std::allocator_traits<Allocator>;
-	using tree_node_type       = typename ab_tree_node<T>::node_type;
-	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
-	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
-	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
-	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
-	using node_type            = typename node_traits_type::value_type;
-	using node_pointer         = typename node_traits_type::pointer;
-	using node_size_type       = typename node_traits_type::size_type;
-	using node_difference_type = typename node_traits_type::difference_type;
+	using value_type             = typename ab_tree_type_traits<Tree, IsConst>::value_type;
+	using pointer                = typename ab_tree_type_traits<Tree, IsConst>::pointer;
+	using reference              = typename ab_tree_type_traits<Tree, IsConst>::reference;
+	using size_type              = typename ab_tree_type_traits<Tree, IsConst>::size_type;
+	using difference_type        = typename ab_tree_type_traits<Tree, IsConst>::difference_type;
+
+	using slice_type             = ab_tree_slice<Tree, IsConst>;
+	using iterator               = ab_tree_iterator<Tree, IsConst>;
+	using reverse_iterator       = std::reverse_iterator<iterator>;
 
 	// construct/copy/destroy:
 
-	ab_tree_node_allocator(void)
-		: allocator()
+	ab_tree_slice(void) noexcept
+		: first()
+		, last()
+		, count(0)
 	{}
-	explicit ab_tree_node_allocator(const Allocator& alloc)
-		: allocator(alloc)
+	ab_tree_slice(iterator first, iterator last) noexcept
+		: first(first)
+		, last(last)
+		, count(static_cast<size_type>(last - first))
 	{}
-	explicit ab_tree_node_allocator(Allocator&& alloc)
-		: allocator(std::forward<Allocator>(alloc))
+	ab_tree_slice(iterator first, iterator last, size_type n) noexcept
+		: first(first)
+		, last(last)
+		, count(n)
 	{}
 
-	~ab_tree_node_allocator(void)
-	{}
+	inline operator ab_tree_slice<Tree, true>(void) const noexcept
+	{
+		return ab_tree_slice<Tree, true>(first, last, count);
+	}
 
-	// ab_tree_node_allocator operations:
+	// iterators:
 
-	inline allocator_type get_allocator(void) noexcept
+	inline iterator begin(void) const noexcept
 	{
-		return allocator;
+		return first;
 	}
-	inline const allocator_type get_allocator(void) const noexcept
+	inline iterator end(void) const noexcept
 	{
-		return allocator;
+		return last;
+	}
+	inline reverse_iterator rbegin(void) const noexcept
+	{
+		return reverse_iterator(last);
+	}
+	inline reverse_iterator rend(void) const noexcept
+	{
+		return reverse_iterator(first);
 	}
 
-	inline node_size_type max_size(void) const noexcept
+	// capacity:
+
+	inline bool empty(void) const noexcept
 	{
-		return node_alloc.max_size();
+		return count == 0;
 	}
 
-protected:
+	inline size_type size(void) const noexcept
+	{
+		return count;
+	}
 
-	template <class ...Args>
-	inline node_pointer create_node(Args&&... args)
+	// element access:
+
+	inline reference operator[](size_type idx) const noexcept
 	{
-		node_pointer p = node_traits_type::allocate(node_alloc, 1);
-		traits_type::construct(allocator, std::addressof(p->data), std::forward<Args>(args)...);
-		return p;
+		return first[static_cast<difference_type>(idx)];
 	}
 
-	inline void destroy_node(const node_pointer p)
+	inline reference front(void) const noexcept
 	{
-		traits_type::destroy(allocator, std::addressof(p->data));
-		node_traits_type::deallocate(node_alloc, p, 1);
+		return *first;
+	}
+
+	inline reference back(void) const noexcept
+	{
+		return *(last - 1);
+	}
+
+	// operations:
+
+	inline slice_type slice(size_type i, size_type j) const noexcept
+	{
+		iterator itr = first + static_cast<difference_type>(i);
+		return slice_type(itr, itr + static_cast<difference_type>(j - i), j - i);
 	}
 
 private:
-	allocator_type      allocator;
-	node_allocator_type node_alloc;
+	iterator  first;
+	iterator  last;
+	size_type count;
 };
 
 
-// Class template ab_tree
-template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
-class ab_tree : public ab_tree_node_allocator<T, Allocator>
+// Class template ab_tree_cursor
+// A cursor keeps the index of its element, so that seeking another index only
+// climbs until the subtree holds the target. That costs O(log n) in the worst
+// case, when the step crosses a boundary high in the tree, and amortised O(1)
+// for sequential steps.
+template <class Tree, bool IsConst>
+class ab_tree_cursor
 {
 public:
 	// types:
 
-	using tree_type                        = ab_tree<T, Allocator>;
-	using tree_traits_type                 = std::allocator_traits<Allocator>;
-	using node_type                        = typename ab_tree_node<T>::node_type;
-	using node_pointer                     = typename node_type*;
-	using const_node_pointer               = typename const node_type*;
-	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
-	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
-	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
-	using value_type                       = typename traits_type::value_type;
-	using reference                        = value_type&;
-	using const_reference                  = const value_type&;
-	using pointer                          = typename traits_type::pointer;
-	using const_pointer                    = typename traits_type::const_pointer;
-	using size_type                        = typename traits_type::size_type;
-	using difference_type                  = typename traits_type::difference_type;
+	using value_type             = typename ab_tree_type_traits<Tree, IsConst>::value_type;
+	using pointer                = typename ab_tree_type_traits<Tree, IsConst>::pointer;
+	using reference              = typename ab_tree_type_traits<Tree, IsConst>::reference;
+	using size_type              = typename ab_tree_type_traits<Tree, IsConst>::size_type;
+	using difference_type        = typename ab_tree_type_traits<Tree, IsConst>::difference_type;
 
-	using iterator                         = ab_tree_iterator<tree_type, false>;
-	using const_iterator                   = ab_tree_iterator<tree_type, true>;
-	using primitive_iterator               = ab_tree_primitive_iterator<tree_type, false>;
-	using const_primitive_iterator         = ab_tree_primitive_iterator<tree_type, true>;
-	using reverse_iterator                 = std::reverse_iterator<iterator>;
-	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
-	using reverse_primitive_iterator       = std::reverse_iterator<primitive_iterator>;
-	using const_reverse_primitive_iterator = std::reverse_iterator<const_primitive_iterator>;
+	using cursor_type            = ab_tree_cursor<Tree, IsConst>;
+	using iterator               = ab_tree_iterator<Tree, IsConst>;
+	using tree_pointer           = typename std::conditional<IsConst, const Tree*, Tree*>::type;
 
 	// construct/copy/destroy:
 
-	explicit ab_tree(const Allocator& alloc = Allocator())
-		: ab_tree_node_allocator<T, Allocator>(alloc)
-		, header(nullptr)
+	ab_tree_cursor(void) noexcept
+		: tree(nullptr)
+		, itr()
+		, idx(0)
+	{}
+	ab_tree_cursor(tree_pointer tree, size_type idx) noexcept
+		: tree(tree)
+		, itr(tree->select(idx))
+		, idx(idx < tree->size() ? idx : tree->size())
+	{}
+
+	inline operator ab_tree_cursor<Tree, true>(void) const noexcept
 	{
-		create_header();
+		return ab_tree_cursor<Tree, true>(tree, itr, idx);
 	}
-	ab_tree(const tree_type& other)
-		: ab_tree_node_allocator<T, Allocator>(other.get_allocator())
-		, header(nullptr)
+
+	// ab_tree_cursor operations:
+
+	inline size_type index(void) const noexcept
 	{
-		create_header();
-		if (other.header->parent)
-			copy_node(other.header->parent);
+		return idx;
 	}
-	ab_tree(const tree_type& other, const Allocator& alloc)
-		: ab_tree_node_allocator<T, Allocator>(alloc)
-		, header(nullptr)
+
+	inline iterator get_iterator(void) const noexcept
 	{
-		create_header();
-		if (other.header->parent)
-			copy_node(other.header->parent);
+		return itr;
 	}
-	ab_tree(tree_type&& other) noexcept
-		: ab_tree_node_allocator<T, Allocator>(other.get_allocator())
-		, header(nullptr)
+
+	// returns true if the cursor is past the last element
+	inline bool at_end(void) const noexcept
 	{
-		create_header();
-		swap(other);
+		return idx == tree->size();
 	}
-	ab_tree(tree_type&& other, const Allocator& alloc) noexcept
-		: ab_tree_node_allocator<T, Allocator>(alloc)
-		, header(nullptr)
+
+	// moves to index i, or past the last element
+	inline cursor_type& seek(size_type i) noexcept
 	{
-		create_header();
-		swap(other);
+		size_type n = tree->size();
+		if (i > n)
+			i = n;
+		if (i != idx)
+		{
+			itr += static_cast<difference_type>(i) - static_cast<difference_type>(idx);
+			idx = i;
+		}
+		return *this;
 	}
-	ab_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
-		: ab_tree_node_allocator<T, Allocator>(alloc)
-		, header(nullptr)
+
+	// element access:
+
+	inline reference operator*(void) const noexcept
 	{
-		create_header();
-		assign(ilist.begin(), ilist.end());
+		return *itr;
 	}
 
-	~ab_tree(void)
+	inline pointer operator->(void) const noexcept
 	{
-		clear();
-		destroy_header();
+		return itr.operator->();
 	}
 
-	inline tree_type& operator=(const tree_type& other)
+	// increment / decrement
+
+	inline cursor_type& operator++(void) noexcept
 	{
-		if (this != &other)
-		{
-			clear();
-			if (other.header->parent)
-				copy_root(other.header->parent);
-		}
+		++itr;
+		++idx;
 		return *this;
 	}
-	inline tree_type& operator=(tree_type&& other) noexcept
+
+	inline cursor_type& operator--(void) noexcept
 	{
-		if (this != &other)
-			swap(other);
+		--itr;
+		--idx;
 		return *this;
 	}
 
-	inline void assign(size_type n, const_reference value)
-	{
-		clear();
-		insert(cend(), n, value);
-	}
-	template <class InputIt>
-	inline void assign(InputIt first, InputIt last)
+	// moves by n, stopping at the first element or past the last one
+	inline cursor_type& operator+=(difference_type n) noexcept
 	{
-		clear();
-		insert(cend(), first, last);
+		difference_type i = static_cast<difference_type>(idx) + n;
+		return seek(i < 0 ? 0 : static_cast<size_type>(i));
 	}
-	inline void assign(std::initializer_list<value_type> ilist)
+
+	inline cursor_type& operator-=(difference_type n) noexcept
 	{
-		assign(ilist.begin(), ilist.end());
+		difference_type i = static_cast<difference_type>(idx) - n;
+		return seek(i < 0 ? 0 : static_cast<size_type>(i));
 	}
 
-	// iterators:
+	// modifiers:
 
-	inline iterator begin(void) noexcept
-	{
-		return iterator(header->left);
-	}
-	inline const_iterator begin(void) const noexcept
+	// inserts an element before the cursor, which then points to it
+	template <class... Args>
+	inline cursor_type& emplace(Args&&... args)
 	{
-		return const_iterator(header->left);
+		static_assert(!IsConst, "A constant cursor of AB-Tree cannot modify the tree.");
+		itr = tree->emplace(itr, std::forward<Args>(args)...);
+		return *this;
 	}
-	inline const_iterator cbegin(void) const noexcept
+
+	inline cursor_type& insert(const value_type& value)
 	{
-		return const_iterator(header->left);
+		return emplace(value);
 	}
-	inline iterator end(void) noexcept
+	inline cursor_type& insert(value_type&& value)
 	{
-		return iterator(header);
+		return emplace(std::move(value));
 	}
-	inline const_iterator end(void) const noexcept
+
+	// erases the element at the cursor, which then points to the next one
+	inline cursor_type& erase(void)
 	{
-		return const_iterator(header);
+		static_assert(!IsConst, "A constant cursor of AB-Tree cannot modify the tree.");
+		itr = tree->erase(itr);
+		return *this;
+	}
+
+private:
+	template <class U, bool B>
+	friend class ab_tree_cursor;
+
+	ab_tree_cursor(tree_pointer tree, iterator itr, size_type idx) noexcept
+		: tree(tree)
+		, itr(itr)
+		, idx(idx)
+	{}
+
+private:
+	tree_pointer tree;
+	iterator     itr;
+	size_type    idx;
+};
+
+
+// Class template ab_tree_edit
+// An edit of a batch inserts value before the element at index, or erases that
+// element. Indices refer to the ab-tree before the batch is applied.
+template <class T>
+struct ab_tree_edit
+{
+	size_t index;
+	bool   erase;
+	T      value;
+};
+
+
+// Class ab_tree_statistics
+// The shape of an ab-tree and the work done by its rotations, rebalancing and
+// lookups by index since it was constructed or its statistics were reset. The
+// work is only counted if ABT_STATISTICS is defined, and is zero otherwise.
+struct ab_tree_statistics
+{
+	size_t node_count;          // nodes holding elements
+	size_t node_bytes;          // bytes of all nodes
+	size_t height;              // the depth of the deepest node, the root at 1
+	double average_depth;
+	size_t rotations;
+	size_t rebalances;          // calls of the rebalancing after insertion or deletion
+	size_t max_rebalance_depth; // the deepest recursion of the rebalancing
+	size_t selections;          // lookups by index
+	size_t select_steps;        // nodes visited by the lookups
+	size_t max_select_steps;
+};
+
+
+#ifdef ABT_STATISTICS
+// Class ab_tree_counters
+// The counters behind ab_tree_statistics. They are relaxed atomics, since the
+// lookups of multi_select may run on several threads at once.
+struct ab_tree_counters
+{
+	std::atomic<size_t> rotations{ 0 };
+	std::atomic<size_t> rebalances{ 0 };
+	std::atomic<size_t> max_rebalance_depth{ 0 };
+	std::atomic<size_t> selections{ 0 };
+	std::atomic<size_t> select_steps{ 0 };
+	std::atomic<size_t> max_select_steps{ 0 };
+	size_t              rebalance_depth = 0;
+
+	inline void rotate(void) noexcept
+	{
+		rotations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// rebalancing only runs on the thread that modifies the tree
+	inline void enter_rebalance(void) noexcept
+	{
+		rebalances.fetch_add(1, std::memory_order_relaxed);
+		raise(max_rebalance_depth, ++rebalance_depth);
+	}
+
+	inline void leave_rebalance(void) noexcept
+	{
+		--rebalance_depth;
+	}
+
+	inline void select(size_t steps) noexcept
+	{
+		selections.fetch_add(1, std::memory_order_relaxed);
+		select_steps.fetch_add(steps, std::memory_order_relaxed);
+		raise(max_select_steps, steps);
+	}
+
+	inline void reset(void) noexcept
+	{
+		rotations = 0;
+		rebalances = 0;
+		max_rebalance_depth = 0;
+		selections = 0;
+		select_steps = 0;
+		max_select_steps = 0;
+	}
+
+	static inline void raise(std::atomic<size_t>& max, size_t value) noexcept
+	{
+		size_t cur = max.load(std::memory_order_relaxed);
+		while (cur < value && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+			;
+	}
+};
+#endif // ABT_STATISTICS
+
+
+// Class template ab_tree_concurrent_allocator
+// Parallel operations only allocate nodes on several threads at once if the
+// node allocator is known to be thread-safe. Specialize it for others.
+template <class Allocator>
+struct ab_tree_concurrent_allocator : std::false_type
+{};
+
+template <class T>
+struct ab_tree_concurrent_allocator<std::allocator<T>> : std::true_type
+{};
+
+
+// Class template ab_tree_node_allocator
+template <class T, class Allocator>
+class ab_tree_node_allocator
+{
+public:
+	// types:
+
+	using tree_traits_type     = std::allocator_traits<Allocator>;
+	using tree_node_type       = typename ab_tree_node<T>::node_type;
+	using allocator_type       = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type          = typename tree_traits_type::template rebind_traits<T>;
+	using node_allocator_type  = typename tree_traits_type::template rebind_alloc<tree_node_type>;
+	using node_traits_type     = typename tree_traits_type::template rebind_traits<tree_node_type>;
+	using node_type            = typename node_traits_type::value_type;
+	using node_pointer         = typename node_traits_type::pointer;
+	using link_pointer         = typename ab_tree_node_links<T>::link_pointer;
+	using node_size_type       = typename node_traits_type::size_type;
+	using node_difference_type = typename node_traits_type::difference_type;
+
+	// construct/copy/destroy:
+
+	ab_tree_node_allocator(void)
+		: allocator()
+		, node_alloc(allocator)
+	{}
+	explicit ab_tree_node_allocator(const Allocator& alloc)
+		: allocator(alloc)
+		, node_alloc(alloc)
+	{}
+	explicit ab_tree_node_allocator(Allocator&& alloc)
+		: allocator(alloc)
+		, node_alloc(std::forward<Allocator>(alloc))
+	{}
+
+	~ab_tree_node_allocator(void)
+	{}
+
+	// ab_tree_node_allocator operations:
+
+	inline allocator_type get_allocator(void) noexcept
+	{
+		return allocator;
+	}
+	inline const allocator_type get_allocator(void) const noexcept
+	{
+		return allocator;
+	}
+
+	inline node_size_type max_size(void) const noexcept
+	{
+		return node_alloc.max_size();
+	}
+
+protected:
+
+	template <class ...Args>
+	inline node_pointer create_node(Args&&... args)
+	{
+		node_pointer p = node_traits_type::allocate(node_alloc, 1);
+		try
+		{
+			traits_type::construct(allocator, std::addressof(p->data), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits_type::deallocate(node_alloc, p, 1);
+			throw;
+		}
+		return p;
+	}
+
+	inline void destroy_node(const link_pointer t)
+	{
+		node_pointer p = static_cast<node_pointer>(t);
+		traits_type::destroy(allocator, std::addressof(p->data));
+		node_traits_type::deallocate(node_alloc, p, 1);
+	}
+
+	// nodes can only move between trees whose node allocators compare equal
+	inline bool equal_allocator(const ab_tree_node_allocator& other) const noexcept
+	{
+		return node_alloc == other.node_alloc;
+	}
+
+	inline void share_allocator(const ab_tree_node_allocator& other)
+	{
+		allocator = other.allocator;
+		node_alloc = other.node_alloc;
+	}
+
+	inline void swap_allocator(ab_tree_node_allocator& other) noexcept
+	{
+		std::swap(allocator, other.allocator);
+		std::swap(node_alloc, other.node_alloc);
+	}
+
+	// releases all nodes at once if the node allocator supports it, where
+	// allocator and node_alloc are the two holders of its pools in a tree
+	inline bool release_nodes(void) noexcept
+	{
+		return release_nodes(node_alloc, 0);
+	}
+
+private:
+
+	template <class Alloc>
+	static inline auto release_nodes(Alloc& alloc, int) noexcept -> decltype(static_cast<bool>(alloc.release(2)))
+	{
+		return alloc.release(2);
+	}
+
+	template <class Alloc>
+	static inline bool release_nodes(Alloc&, long) noexcept
+	{
+		return false;
+	}
+
+private:
+	allocator_type      allocator;
+	node_allocator_type node_alloc;
+};
+
+
+// Class template ab_tree
+template <class T, class Allocator = DEFAULT_ALLOCATOR(T)>
+class ab_tree : public ab_tree_node_allocator<T, Allocator>
+{
+public:
+	// types:
+
+	using tree_type                        = ab_tree<T, Allocator>;
+	using tree_traits_type                 = std::allocator_traits<Allocator>;
+	using node_type                        = typename ab_tree_node<T>::node_type;
+	using node_pointer                     = typename ab_tree_node_links<T>::link_pointer;
+	using const_node_pointer               = const ab_tree_node_links<T>*;
+	using node_allocator_type              = typename tree_traits_type::template rebind_alloc<node_type>;
+	using allocator_type                   = typename tree_traits_type::template rebind_alloc<T>;
+	using traits_type                      = typename tree_traits_type::template rebind_traits<T>;
+	using value_type                       = typename traits_type::value_type;
+	using reference                        = value_type&;
+	using const_reference                  = const value_type&;
+	using pointer                          = typename traits_type::pointer;
+	using const_pointer                    = typename traits_type::const_pointer;
+	using size_type                        = typename traits_type::size_type;
+	using difference_type                  = typename traits_type::difference_type;
+
+	using iterator                         = ab_tree_iterator<tree_type, false>;
+	using const_iterator                   = ab_tree_iterator<tree_type, true>;
+	using primitive_iterator               = ab_tree_primitive_iterator<tree_type, false>;
+	using const_primitive_iterator         = ab_tree_primitive_iterator<tree_type, true>;
+	using reverse_iterator                 = std::reverse_iterator<iterator>;
+	using const_reverse_iterator           = std::reverse_iterator<const_iterator>;
+	using reverse_primitive_iterator       = std::reverse_iterator<primitive_iterator>;
+	using const_reverse_primitive_iterator = std::reverse_iterator<const_primitive_iterator>;
+	using slice_type                       = ab_tree_slice<tree_type, false>;
+	using const_slice_type                 = ab_tree_slice<tree_type, true>;
+	using cursor_type                      = ab_tree_cursor<tree_type, false>;
+	using const_cursor_type                = ab_tree_cursor<tree_type, true>;
+	using edit_type                        = ab_tree_edit<value_type>;
+
+	// construct/copy/destroy:
+
+	explicit ab_tree(const Allocator& alloc = Allocator())
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+	}
+	ab_tree(const tree_type& other)
+		: ab_tree_node_allocator<T, Allocator>(other.get_allocator())
+		, header(&head)
+	{
+		reset_header();
+		if (other.header->parent)
+			copy_node(other.header->parent);
+	}
+	ab_tree(const tree_type& other, const Allocator& alloc)
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+		if (other.header->parent)
+			copy_node(other.header->parent);
+	}
+	ab_tree(tree_type&& other) noexcept
+		: ab_tree_node_allocator<T, Allocator>(other)
+		, header(&head)
+	{
+		reset_header();
+		swap(other);
+	}
+	ab_tree(tree_type&& other, const Allocator& alloc) noexcept
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+		swap(other);
+	}
+	ab_tree(size_type n, const_reference value, const Allocator& alloc = Allocator())
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+		assign(n, value);
+	}
+	template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+	ab_tree(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+		assign(first, last);
+	}
+	ab_tree(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+		: ab_tree_node_allocator<T, Allocator>(alloc)
+		, header(&head)
+	{
+		reset_header();
+		assign(ilist.begin(), ilist.end());
+	}
+
+	~ab_tree(void)
+	{
+		clear();
+	}
+
+	inline tree_type& operator=(const tree_type& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			if (other.header->parent)
+				copy_root(other.header->parent);
+		}
+		return *this;
+	}
+	inline tree_type& operator=(tree_type&& other) noexcept
+	{
+		if (this != &other)
+			swap(other);
+		return *this;
+	}
+
+	inline void assign(size_type n, const_reference value)
+	{
+		clear();
+		insert(cend(), n, value);
+	}
+	template <class InputIt>
+	inline void assign(InputIt first, InputIt last)
+	{
+		clear();
+		insert(cend(), first, last);
+	}
+	inline void assign(std::initializer_list<value_type> ilist)
+	{
+		assign(ilist.begin(), ilist.end());
+	}
+
+	// constructs an ab-tree of n elements, each generated by calling gen()
+	template <class Generator>
+	static tree_type generate(size_type n, Generator gen, const Allocator& alloc = Allocator())
+	{
+		tree_type tree(alloc);
+		tree.build_root(n, [&]() { return tree.create_node(gen()); });
+		return tree;
+	}
+
+	// Parallel operations split the work at subtrees on up to threads threads,
+	// or on one thread per core if threads is 0.
+
+	// constructs a copy of the ab-tree in parallel
+	inline tree_type parallel_copy(size_type threads = 0) const
+	{
+		tree_type tree(this->get_allocator());
+		if (header->parent)
+			tree.link_root(tree.copy_subtree(header->parent, thread_count(threads, true)));
+		return tree;
+	}
+
+	// replaces the contents with the elements of a random access range in parallel
+	template <class RandomIt>
+	void parallel_assign(RandomIt first, RandomIt last, size_type threads = 0)
+	{
+		clear();
+		auto create = [&](size_type i) { return this->create_node(first[i]); };
+		if (first != last)
+			link_root(build_subtree(0, static_cast<size_type>(last - first), thread_count(threads, true), create));
+	}
+
+	// constructs an ab-tree of n elements in parallel, the element at index i
+	// is generated by calling gen(i), possibly on several threads at once
+	template <class Generator>
+	static tree_type parallel_generate(size_type n, Generator gen, size_type threads = 0, const Allocator& alloc = Allocator())
+	{
+		tree_type tree(alloc);
+		auto create = [&](size_type i) { return tree.create_node(gen(i)); };
+		if (n > 0)
+			tree.link_root(tree.build_subtree(0, n, thread_count(threads, true), create));
+		return tree;
+	}
+
+	// calls f on each element in parallel, in no particular order
+	template <class Function>
+	void parallel_for_each(Function f, size_type threads = 0)
+	{
+		threads = thread_count(threads);
+		parallel_chunks(chunk_count(threads), threads, [&](size_type, size_type idx, size_type n)
+		{
+			for (iterator itr = select(idx); n > 0; --n, ++itr)
+				f(*itr);
+		});
+	}
+	template <class Function>
+	void parallel_for_each(Function f, size_type threads = 0) const
+	{
+		threads = thread_count(threads);
+		parallel_chunks(chunk_count(threads), threads, [&](size_type, size_type idx, size_type n)
+		{
+			for (const_iterator itr = select(idx); n > 0; --n, ++itr)
+				f(*itr);
+		});
+	}
+
+	// reduces the transformed elements in parallel, reduce must be associative
+	template <class U, class Reduce, class Transform>
+	U parallel_transform_reduce(U init, Reduce reduce, Transform transform, size_type threads = 0) const
+	{
+		if (empty())
+			return init;
+		threads = thread_count(threads);
+		size_type count = chunk_count(threads);
+		std::vector<U> partial(count, init);
+		parallel_chunks(count, threads, [&](size_type c, size_type idx, size_type n)
+		{
+			const_iterator itr = select(idx);
+			U acc = transform(*itr);
+			while (--n > 0)
+				acc = reduce(std::move(acc), transform(*++itr));
+			partial[c] = std::move(acc);
+		});
+		for (auto& x : partial)
+			init = reduce(std::move(init), std::move(x));
+		return init;
+	}
+
+	// writes the inclusive prefix sums to the random access range from d_first
+	// on in parallel, op must be associative and d_first may be begin()
+	template <class RandomIt, class BinaryOp = std::plus<value_type>>
+	RandomIt parallel_inclusive_scan(RandomIt d_first, BinaryOp op = BinaryOp(), size_type threads = 0) const
+	{
+		if (empty())
+			return d_first;
+		threads = thread_count(threads);
+		size_type count = chunk_count(threads);
+		std::vector<value_type> sums;
+		if (count > 1)
+			sums = chunk_sums(count, threads, op);
+		parallel_chunks(count, threads, [&](size_type c, size_type idx, size_type n)
+		{
+			const_iterator itr = select(idx);
+			RandomIt out = d_first + static_cast<difference_type>(idx);
+			value_type acc = c ? op(sums[c - 1], *itr) : *itr;
+			*out = acc;
+			while (--n > 0)
+			{
+				acc = op(std::move(acc), *++itr);
+				*++out = acc;
+			}
+		});
+		return d_first + static_cast<difference_type>(size());
+	}
+
+	// writes the exclusive prefix sums starting from init to the random access
+	// range from d_first on in parallel, op must be associative and d_first
+	// may be begin()
+	template <class RandomIt, class BinaryOp = std::plus<value_type>>
+	RandomIt parallel_exclusive_scan(RandomIt d_first, value_type init, BinaryOp op = BinaryOp(), size_type threads = 0) const
+	{
+		if (empty())
+			return d_first;
+		threads = thread_count(threads);
+		size_type count = chunk_count(threads);
+		std::vector<value_type> sums;
+		if (count > 1)
+			sums = chunk_sums(count, threads, op);
+		parallel_chunks(count, threads, [&](size_type c, size_type idx, size_type n)
+		{
+			const_iterator itr = select(idx);
+			RandomIt out = d_first + static_cast<difference_type>(idx);
+			value_type acc = c ? op(init, sums[c - 1]) : init;
+			for (; n > 0; --n, ++itr, ++out)
+			{
+				value_type next = op(acc, *itr);
+				*out = std::move(acc);
+				acc = std::move(next);
+			}
+		});
+		return d_first + static_cast<difference_type>(size());
+	}
+
+	// iterators:
+
+	inline iterator begin(void) noexcept
+	{
+		return iterator(header->left);
+	}
+	inline const_iterator begin(void) const noexcept
+	{
+		return const_iterator(header->left);
+	}
+	inline const_iterator cbegin(void) const noexcept
+	{
+		return const_iterator(header->left);
+	}
+	inline iterator end(void) noexcept
+	{
+		return iterator(header);
+	}
+	inline const_iterator end(void) const noexcept
+	{
+		return const_iterator(header);
 	}
 	inline const_iterator cend(void) const noexcept
 	{
@@ -739,11 +1484,11 @@ public:
 
 	inline reference operator[](size_type idx) noexcept
 	{
-		return select_node(idx)->data;
+		return select_node(idx)->value();
 	}
 	inline const_reference operator[](size_type idx) const noexcept
 	{
-		return select_node(idx)->data;
+		return select_node(idx)->value();
 	}
 
 	inline reference at(size_type idx)
@@ -752,7 +1497,7 @@ public:
 			throw std::domain_error(ABT_NOT_INITIALIZED);
 		if (idx >= size())
 			throw std::out_of_range(ABT_OUT_OF_RANGE);
-		return select_node(idx)->data;
+		return select_node(idx)->value();
 	}
 	inline const_reference at(size_type idx) const
 	{
@@ -760,7 +1505,7 @@ public:
 			throw std::domain_error(ABT_NOT_INITIALIZED);
 		if (idx >= size())
 			throw std::out_of_range(ABT_OUT_OF_RANGE);
-		return select_node(idx)->data;
+		return select_node(idx)->value();
 	}
 
 	inline reference front(void)
@@ -846,30 +1591,13 @@ public:
 	}
 	inline iterator insert(const_iterator pos, size_type n, const_reference value)
 	{
-		node_pointer r, t = pos.get_pointer();
-		if (n > 0)
-		{
-			r = insert_node(t, value);
-			for (; n > 1; --n)
-				insert_node(t, value);
-		}
-		else
-			r = t;
-		return iterator(r);
+		return iterator(insert_nodes(pos.get_pointer(), n, [&]() { return this->create_node(value); }));
 	}
 	template <class InputIt>
 	inline iterator insert(const_iterator pos, InputIt first, InputIt last)
 	{
-		node_pointer r, t = pos.get_pointer();
-		if (first != last)
-		{
-			r = insert_node(t, *first);
-			for (++first; first != last; ++first)
-				insert_node(t, *first);
-		}
-		else
-			r = t;
-		return iterator(r);
+		return iterator(insert_range(pos.get_pointer(), first, last,
+			typename std::iterator_traits<InputIt>::iterator_category()));
 	}
 	inline iterator insert(const_iterator pos, std::initializer_list<value_type> ilist)
 	{
@@ -885,152 +1613,1052 @@ public:
 	}
 	inline iterator insert(size_type idx, size_type n, const_reference value)
 	{
-		return insert(select(idx), n, value);
+		return insert(select(idx), n, value);
+	}
+	template <class InputIt>
+	inline iterator insert(size_type idx, InputIt first, InputIt last)
+	{
+		return insert(select(idx), first, last);
+	}
+	inline iterator insert(size_type idx, std::initializer_list<value_type> ilist)
+	{
+		return insert(idx, ilist.begin(), ilist.end());
+	}
+
+	inline iterator erase(const_iterator pos)
+	{
+		iterator next = iterator(pos.get_pointer());
+		if (pos != cend())
+		{
+			++next;
+			erase_node(pos.get_pointer());
+		}
+		return next;
+	}
+	inline iterator erase(const_iterator first, const_iterator last)
+	{
+		iterator next = iterator(last.get_pointer());
+		if (first == cbegin() && last == cend())
+			clear();
+		else if (first != last)
+		{
+			size_type idx = first.get_index();
+			erase_nodes(first.get_pointer(), idx, last.get_index() - idx);
+		}
+		return next;
+	}
+	inline void erase(size_type idx)
+	{
+		node_pointer t = select_node(idx);
+		if (t != header)
+			erase_node(t);
+	}
+	inline void erase(size_type idx, size_type n)
+	{
+		size_type count = size();
+		if (idx < count && n > 0)
+			erase_nodes(select_node(idx), idx, n < count - idx ? n : count - idx);
+	}
+
+	// moves the elements from index idx on into the returned ab-tree in O(log n)
+	inline tree_type split(size_type idx)
+	{
+		tree_type other(this->get_allocator());
+		other.share_allocator(*this);
+		if (idx < size())
+		{
+			node_pointer l, r;
+			split_root(idx, l, r);
+			link_root(l);
+			other.link_root(r);
+		}
+		return other;
+	}
+
+	// appends the elements of other in O(log n) and leaves it empty
+	inline void concat(tree_type&& other)
+	{
+		if (this == &other || !other.header->parent)
+			return;
+		if (!header->parent)
+		{
+			swap(other);
+			return;
+		}
+		if (!this->equal_allocator(other))
+		{
+			// the nodes of other cannot be released by this allocator
+			insert(cend(), std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+			other.clear();
+			return;
+		}
+		node_pointer l = header->parent;
+		node_pointer r = other.header->parent;
+		// unlinks both roots and hangs them off this header
+		header->parent = nullptr;
+		other.link_root(nullptr);
+		if (l)
+			l->parent = header;
+		r->parent = header;
+		link_root(concat_node(l, r));
+	}
+
+	// moves the elements of other before the element at index idx in O(log n),
+	// which only links the node if other has one element, so an element made
+	// in advance is inserted without allocation or exceptions
+	inline void splice(size_type idx, tree_type&& other)
+	{
+		if (this == &other || !other.header->parent)
+			return;
+		if (!this->equal_allocator(other))
+		{
+			// the nodes of other cannot be released by this allocator
+			insert(select(idx), std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+			other.clear();
+			return;
+		}
+		node_pointer m = other.header->parent;
+		other.reset_header();
+		if (m->size == 1)
+		{
+			link_node(select_node(idx), m);
+			return;
+		}
+		node_pointer l, r;
+		split_root(idx < size() ? idx : size(), l, r);
+		m->parent = header;
+		link_root(concat_node(concat_node(l, m), r));
+	}
+
+	// applies a batch of edits sorted by index, where the inserts at an index
+	// come before the erase of its element, in one sweep over the tree
+	template <class ForwardIt>
+	void apply_edits(ForwardIt first, ForwardIt last)
+	{
+		// checks the batch and creates the new nodes before the tree is cut,
+		// with room for them all so that storing a new node cannot throw
+		std::vector<node_pointer> nodes;
+		nodes.reserve(static_cast<size_type>(std::count_if(first, last, [](const edit_type& e) { return !e.erase; })));
+		size_type prev = 0;
+		bool erased = false;
+		try
+		{
+			for (ForwardIt itr = first; itr != last; ++itr)
+			{
+				const edit_type& e = *itr;
+				if (e.index > size() || (e.erase && e.index == size()))
+					throw std::out_of_range(ABT_OUT_OF_RANGE);
+				if (e.index < prev || (e.index == prev && erased))
+					throw std::invalid_argument(ABT_UNSORTED_EDITS);
+				prev = e.index;
+				erased = e.erase;
+				if (!e.erase)
+					nodes.push_back(this->create_node(e.value));
+			}
+		}
+		catch (...)
+		{
+			for (node_pointer t : nodes)
+				this->destroy_node(t);
+			throw;
+		}
+		if (first == last)
+			return;
+		node_pointer t = header->parent;
+		header->parent = nullptr;
+		if (t)
+			t->parent = header;
+		node_pointer* next = nodes.data();
+		link_root(edit_subtree(t, 0, first, last, next));
+	}
+
+	inline void swap(tree_type& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			std::swap(head, rhs.head);
+			relink_header();
+			rhs.relink_header();
+			this->swap_allocator(rhs);
+		}
+	}
+
+	inline void clear(void)
+	{
+		if (header->parent)
+		{
+			// a pool can drop all nodes at once if the elements need no destruction
+			if (!std::is_trivially_destructible<value_type>::value || !this->release_nodes())
+				erase_root();
+			reset_header();
+		}
+	}
+
+	// operations:
+
+	inline iterator select(size_type idx) noexcept
+	{
+		return iterator(select_node(idx));
+	}
+	inline const_iterator select(size_type idx) const noexcept
+	{
+		return const_iterator(select_node(idx));
+	}
+
+	inline size_type index_of(const_iterator pos) const noexcept
+	{
+		return pos.get_index();
+	}
+
+	inline slice_type slice(size_type first, size_type last) noexcept
+	{
+		iterator itr = select(first);
+		return slice_type(itr, itr + static_cast<difference_type>(last - first), last - first);
+	}
+	inline const_slice_type slice(size_type first, size_type last) const noexcept
+	{
+		const_iterator itr = select(first);
+		return const_slice_type(itr, itr + static_cast<difference_type>(last - first), last - first);
+	}
+
+	inline cursor_type cursor(size_type idx = 0) noexcept
+	{
+		return cursor_type(this, idx);
+	}
+	inline const_cursor_type cursor(size_type idx = 0) const noexcept
+	{
+		return const_cursor_type(this, idx);
+	}
+
+	// copies the elements at the indices in [first, last), which must all be
+	// less than size(), to d_first in the same order. Sorted indices are
+	// resolved in one pass over the tree that shares the paths of nearby
+	// indices, and others by lookups interleaved in groups so that their
+	// cache misses overlap. Large batches are split while threads are left.
+	template <class InputIt, class OutputIt>
+	OutputIt multi_select(InputIt first, InputIt last, OutputIt d_first, size_type threads = 1) const
+	{
+		std::vector<size_type> indices(first, last);
+		size_type n = indices.size();
+		std::vector<node_pointer> nodes(n);
+		threads = thread_count(threads);
+		if (std::is_sorted(indices.begin(), indices.end()))
+			select_nodes(header->parent, 0, indices.data(), indices.data() + n, nodes.data(), threads);
+		else
+		{
+			const size_type* p = indices.data();
+			node_pointer* out = nodes.data();
+			size_type count = n / parallel_grain + 1;
+			if (count > threads)
+				count = threads;
+			std::vector<std::future<void>> workers;
+			for (size_type c = 1; c < count; ++c)
+				workers.push_back(std::async(std::launch::async, [=]()
+				{
+					select_groups(p + n * c / count, p + n * (c + 1) / count, out + n * c / count);
+				}));
+			select_groups(p, p + n / count, out);
+			for (auto& w : workers)
+				w.get();
+		}
+		for (node_pointer t : nodes)
+			*d_first++ = t->value();
+		return d_first;
+	}
+
+	// measures the shape of the tree in O(n), and reports the work counted
+	// if ABT_STATISTICS is defined
+	ab_tree_statistics statistics(void) const
+	{
+		ab_tree_statistics stats = {};
+		size_type total = 0;
+		measure_depth(header->parent, 1, stats.height, total);
+		stats.node_count = size();
+		stats.node_bytes = stats.node_count * sizeof(node_type);
+		stats.average_depth = stats.node_count ? static_cast<double>(total) / static_cast<double>(stats.node_count) : 0;
+#ifdef ABT_STATISTICS
+		stats.rotations = counters.rotations.load(std::memory_order_relaxed);
+		stats.rebalances = counters.rebalances.load(std::memory_order_relaxed);
+		stats.max_rebalance_depth = counters.max_rebalance_depth.load(std::memory_order_relaxed);
+		stats.selections = counters.selections.load(std::memory_order_relaxed);
+		stats.select_steps = counters.select_steps.load(std::memory_order_relaxed);
+		stats.max_select_steps = counters.max_select_steps.load(std::memory_order_relaxed);
+#endif // ABT_STATISTICS
+		return stats;
+	}
+
+	inline void reset_statistics(void) noexcept
+	{
+		ABT_STATISTIC(counters.reset());
+	}
+
+	// Saved trees keep their shape: two bits per node in pre-order tell if
+	// it has a left and a right child, followed by the elements in the same
+	// order, so loading rebuilds the same tree in O(n) without rotations.
+	// Trivially copyable elements are copied as bytes in native byte order,
+	// others are written by write(os, value) and read back by read(is).
+
+	// writes the tree to a binary stream
+	inline void save(std::ostream& os) const
+	{
+		static_assert(std::is_trivially_copyable<value_type>::value, "elements must be trivially copyable");
+		save_nodes(os, true, [&](const_primitive_iterator itr, const_primitive_iterator last)
+		{
+			save_bytes(os, itr, last);
+		});
+	}
+	template <class Writer>
+	void save(std::ostream& os, Writer write) const
+	{
+		save_nodes(os, false, [&](const_primitive_iterator itr, const_primitive_iterator last)
+		{
+			for (; itr != last; ++itr)
+				if (itr.get_state() != ab_tree_state_parent)
+					write(os, *itr);
+		});
+	}
+	inline void save(const std::string& filename) const
+	{
+		std::ofstream os(filename, std::ios::binary);
+		save(os);
+		close_file(os);
+	}
+	template <class Writer>
+	void save(const std::string& filename, Writer write) const
+	{
+		std::ofstream os(filename, std::ios::binary);
+		save(os, write);
+		close_file(os);
+	}
+
+	// reads a tree written by save from a binary stream
+	static tree_type load(std::istream& is, const Allocator& alloc = Allocator())
+	{
+		static_assert(std::is_trivially_copyable<value_type>::value, "elements must be trivially copyable");
+		using storage_type = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+		tree_type tree(alloc);
+		std::vector<storage_type> buffer;
+		size_type pos = 0;
+		tree.load_nodes(is, true, [&](size_type remaining)
+		{
+			if (pos == buffer.size())
+			{
+				// reads the elements in blocks
+				buffer.resize(std::min<size_type>(remaining, stream_block / sizeof(value_type) + 1));
+				read_bytes(is, reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(value_type));
+				pos = 0;
+			}
+			return tree.create_node(*reinterpret_cast<const value_type*>(&buffer[pos++]));
+		});
+		return tree;
+	}
+	template <class Reader>
+	static tree_type load(std::istream& is, Reader read, const Allocator& alloc = Allocator())
+	{
+		tree_type tree(alloc);
+		tree.load_nodes(is, false, [&](size_type) { return tree.create_node(read(is)); });
+		return tree;
+	}
+	static tree_type load(const std::string& filename, const Allocator& alloc = Allocator())
+	{
+		std::ifstream is(filename, std::ios::binary);
+		if (!is)
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+		return load(is, alloc);
+	}
+	template <class Reader>
+	static tree_type load(const std::string& filename, Reader read, const Allocator& alloc = Allocator())
+	{
+		std::ifstream is(filename, std::ios::binary);
+		if (!is)
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+		return load(is, read, alloc);
+	}
+
+private:
+
+	// the header of a saved tree
+	static constexpr uint32_t stream_magic   = 0x41425431; // "ABT1", detects a foreign byte order
+	static constexpr uint32_t stream_version = 1;
+	static constexpr uint32_t stream_raw     = 1;          // the elements are copied as bytes
+	static constexpr size_type stream_block  = 1 << 16;
+
+	static inline void close_file(std::ofstream& os)
+	{
+		os.close();
+		if (!os)
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+	}
+
+	static inline void write_bytes(std::ostream& os, const void* p, size_type n)
+	{
+		if (!os.write(static_cast<const char*>(p), static_cast<std::streamsize>(n)))
+			throw std::ios_base::failure(ABT_STREAM_FAILED);
+	}
+
+	static inline void read_bytes(std::istream& is, void* p, size_type n)
+	{
+		if (!is.read(static_cast<char*>(p), static_cast<std::streamsize>(n)))
+			throw std::ios_base::failure(is.eof() ? ABT_BAD_STREAM : ABT_STREAM_FAILED);
+	}
+
+	// writes the elements of a pre-order walk as bytes, gathered in blocks
+	static void save_bytes(std::ostream& os, const_primitive_iterator itr, const_primitive_iterator last)
+	{
+		std::vector<char> block;
+		block.reserve(stream_block + sizeof(value_type));
+		for (; itr != last; ++itr)
+		{
+			if (itr.get_state() == ab_tree_state_parent)
+				continue;
+			const char* p = reinterpret_cast<const char*>(std::addressof(*itr));
+			block.insert(block.end(), p, p + sizeof(value_type));
+			if (block.size() >= stream_block)
+			{
+				write_bytes(os, block.data(), block.size());
+				block.clear();
+			}
+		}
+		write_bytes(os, block.data(), block.size());
+	}
+
+	// writes the header and the shape, then the elements by save_elements
+	template <class SaveElements>
+	void save_nodes(std::ostream& os, bool raw, SaveElements save_elements) const
+	{
+		uint32_t info[4] = { stream_magic, stream_version, raw ? stream_raw : 0, static_cast<uint32_t>(sizeof(value_type)) };
+		uint64_t count = size();
+		write_bytes(os, info, sizeof(info));
+		write_bytes(os, &count, sizeof(count));
+		if (count == 0)
+			return;
+		std::vector<unsigned char> block;
+		block.reserve(stream_block);
+		unsigned char bits = 0;
+		unsigned shift = 0;
+		for (const_primitive_iterator itr = pbegin(); itr != pend(); ++itr)
+		{
+			if (itr.get_state() == ab_tree_state_parent)
+				continue;
+			node_pointer t = itr.get_pointer();
+			bits |= static_cast<unsigned char>(((t->left ? 1 : 0) | (t->right ? 2 : 0)) << shift);
+			if ((shift += 2) == 8)
+			{
+				block.push_back(bits);
+				bits = 0;
+				shift = 0;
+				if (block.size() == stream_block)
+				{
+					write_bytes(os, block.data(), block.size());
+					block.clear();
+				}
+			}
+		}
+		if (shift)
+			block.push_back(bits);
+		write_bytes(os, block.data(), block.size());
+		save_elements(pbegin(), pend());
+	}
+
+	// rebuilds the saved shape, the tree must be empty and create(remaining)
+	// makes the next node in pre-order
+	template <class Creator>
+	void load_nodes(std::istream& is, bool raw, Creator create)
+	{
+		uint32_t info[4];
+		uint64_t count;
+		read_bytes(is, info, sizeof(info));
+		read_bytes(is, &count, sizeof(count));
+		if (info[0] != stream_magic || info[1] != stream_version || (info[2] & stream_raw) != (raw ? stream_raw : 0) ||
+			(raw && info[3] != sizeof(value_type)) || count > this->max_size())
+			throw std::ios_base::failure(ABT_BAD_STREAM);
+		size_type n = static_cast<size_type>(count);
+		if (n == 0)
+			return;
+		// the shape grows with what is read, so a bad count fails before it is allocated
+		std::vector<unsigned char> shape;
+		for (size_type bytes = (n + 3) / 4; shape.size() < bytes; )
+		{
+			size_type k = shape.size();
+			shape.resize(k + std::min(bytes - k, stream_block));
+			read_bytes(is, shape.data() + k, shape.size() - k);
+		}
+		// the nodes on the path from the root whose subtrees are unfinished
+		std::vector<std::pair<node_pointer, unsigned>> path;
+		node_pointer root = nullptr;
+		node_pointer* slot = &root;
+		node_pointer parent = header;
+		try
+		{
+			for (size_type i = 0; i < n; ++i)
+			{
+				if (!slot)
+					throw std::ios_base::failure(ABT_BAD_STREAM);
+				unsigned bits = (shape[i / 4] >> (i % 4 * 2)) & 3;
+				node_pointer t = create(n - i);
+				t->left = nullptr;
+				t->right = nullptr;
+				t->parent = parent;
+				t->size = 1;
+				*slot = t;
+				path.emplace_back(t, bits);
+				if (bits)
+				{
+					parent = t;
+					slot = (bits & 1) ? &t->left : &t->right;
+					continue;
+				}
+				// climbs until a right subtree is still to come, and sums the sizes on the way
+				slot = nullptr;
+				path.pop_back();
+				while (!path.empty())
+				{
+					node_pointer p = path.back().first;
+					if (t == p->left && (path.back().second & 2))
+					{
+						parent = p;
+						slot = &p->right;
+						break;
+					}
+					p->size = 1 + size_of(p->left) + size_of(p->right);
+					path.pop_back();
+					t = p;
+				}
+			}
+			if (slot)
+				throw std::ios_base::failure(ABT_BAD_STREAM);
+		}
+		catch (...)
+		{
+			destroy_subtree(root);
+			throw;
+		}
+		link_root(root);
+	}
+
+	inline node_pointer root(void) const noexcept
+	{
+		return header->parent ? header->parent : header;
 	}
-	template <class InputIt>
-	inline iterator insert(size_type idx, InputIt first, InputIt last)
+
+	inline size_type size_of(const node_pointer t) const noexcept
 	{
-		return insert(select(idx), first, last);
+		return t ? t->size : 0;
 	}
-	inline iterator insert(size_type idx, std::initializer_list<value_type> ilist)
+
+	inline node_pointer leftmost(node_pointer t) const noexcept
 	{
-		return insert(idx, ilist.begin(), ilist.end());
+		while (t->left)
+			t = t->left;
+		return t;
 	}
 
-	inline iterator erase(const_iterator pos)
+	// adds the depths of the nodes of subtree t to total, and raises height
+	// to the deepest of them
+	void measure_depth(const_node_pointer t, size_type depth, size_t& height, size_type& total) const noexcept
 	{
-		iterator next = iterator(pos.get_pointer());
-		if (pos != cend())
+		for (; t; t = t->right, ++depth)
 		{
-			++next;
-			erase_node(pos.get_pointer());
+			if (height < depth)
+				height = depth;
+			total += depth;
+			measure_depth(t->left, depth + 1, height, total);
 		}
-		return next;
 	}
-	inline iterator erase(const_iterator first, const_iterator last)
+
+	inline node_pointer rightmost(node_pointer t) const noexcept
 	{
-		iterator next = iterator(last.get_pointer());
-		if (first == cbegin() && last == cend())
-			clear();
-		else
-			while (first != last)
-				erase(first++);
-		return next;
+		while (t->right)
+			t = t->right;
+		return t;
 	}
-	inline void erase(size_type idx)
+
+	// the header of an empty tree links to itself
+	inline void reset_header(void) noexcept
 	{
-		node_pointer t = select_node(idx);
-		if (t != header)
-			erase_node(t);
+		header->parent = nullptr;
+		header->left = header;
+		header->right = header;
+		header->size = 0;
 	}
-	inline void erase(size_type idx, size_type n)
+
+	// points the root back at the header after the links were copied in
+	inline void relink_header(void) noexcept
 	{
-		iterator itr = select(idx);
-		node_pointer t = itr.get_pointer();
-		for (; n > 0 && itr != cend(); --n)
+		if (header->parent)
+			header->parent->parent = header;
+		else
 		{
-			++itr;
-			erase_node(t);
-			t = itr.get_pointer();
+			header->left = header;
+			header->right = header;
 		}
 	}
 
-	inline void swap(tree_type& rhs) noexcept
+	template <class InputIt>
+	node_pointer insert_range(node_pointer t, InputIt first, InputIt last, std::input_iterator_tag)
 	{
-		if (this != &rhs)
-			std::swap(header, rhs.header);
+		node_pointer r;
+		if (first != last)
+		{
+			r = insert_node(t, *first);
+			for (++first; first != last; ++first)
+				insert_node(t, *first);
+		}
+		else
+			r = t;
+		return r;
 	}
 
-	inline void clear(void)
+	template <class ForwardIt>
+	node_pointer insert_range(node_pointer t, ForwardIt first, ForwardIt last, std::forward_iterator_tag)
 	{
-		if (header->parent)
+		size_type n = static_cast<size_type>(std::distance(first, last));
+		return insert_nodes(t, n, [&]() {
+			node_pointer p = this->create_node(*first);
+			++first;
+			return p;
+		});
+	}
+
+	// inserts n nodes created in order by create() before node t in O(n + log(size))
+	template <class Creator>
+	node_pointer insert_nodes(node_pointer t, size_type n, Creator create)
+	{
+		if (n < 16)
 		{
-			erase_root();
-			header->parent = nullptr;
-			header->left = header;
-			header->right = header;
+			// inserting a few nodes one by one is cheaper than split and join
+			node_pointer first = t;
+			for (size_type i = 0; i < n; ++i)
+			{
+				node_pointer p = link_node(t, create());
+				if (i == 0)
+					first = p;
+			}
+			return first;
+		}
+		// builds the tree directly if it is empty
+		if (!header->parent)
+		{
+			build_root(n, create);
+			return header->left;
+		}
+		// builds the new nodes, the first and the last of them join the parts
+		node_pointer first = create();
+		node_pointer m = nullptr;
+		node_pointer last;
+		try
+		{
+			m = build_node(n - 2, create);
+			last = create();
+		}
+		catch (...)
+		{
+			destroy_subtree(m);
+			this->destroy_node(first);
+			throw;
+		}
+		node_pointer l, r;
+		// grafts them at the position of node t
+		split_root(const_iterator(t).get_index(), l, r);
+		m->parent = header;
+		link_root(join_node(l, first, join_node(m, last, r)));
+		return first;
+	}
+
+	// builds a perfectly balanced subtree of n nodes, created in order by create()
+	template <class Creator>
+	node_pointer build_node(size_type n, Creator& create)
+	{
+		size_type left_size = (n - 1) / 2;
+		size_type right_size = n - 1 - left_size;
+		node_pointer l = left_size ? build_node(left_size, create) : nullptr;
+		node_pointer t;
+		try
+		{
+			t = create();
+		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			throw;
+		}
+		node_pointer r = nullptr;
+		if (right_size)
+		{
+			try
+			{
+				r = build_node(right_size, create);
+			}
+			catch (...)
+			{
+				destroy_subtree(l);
+				this->destroy_node(t);
+				throw;
+			}
 		}
+		return link_children(t, l, r, n);
 	}
 
-	// operations:
-
-	inline iterator select(size_type idx) noexcept
+	// builds the tree of n nodes in O(n), the tree must be empty
+	template <class Creator>
+	void build_root(size_type n, Creator create)
 	{
-		return iterator(select_node(idx));
+		if (n > 0)
+			link_root(build_node(n, create));
 	}
-	inline const_iterator select(size_type idx) const noexcept
+
+	// the smallest subtree whose halves are handed to different threads
+	static constexpr size_type parallel_grain = 4096;
+
+	// the number of threads to use, nodes are allocated if allocates is true
+	static inline size_type thread_count(size_type threads, bool allocates = false) noexcept
 	{
-		return const_iterator(select_node(idx));
+		if (allocates && !ab_tree_concurrent_allocator<node_allocator_type>::value)
+			return 1;
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+		return threads ? threads : 1;
 	}
 
-private:
+	// runs left() on a new thread and right() on this one, and destroys the
+	// nodes made by one if the other throws
+	template <class Left, class Right>
+	void fork_nodes(node_pointer& l, node_pointer& r, Left left, Right right)
+	{
+		std::future<node_pointer> f = std::async(std::launch::async, left);
+		try
+		{
+			r = right();
+		}
+		catch (...)
+		{
+			try
+			{
+				destroy_subtree(f.get());
+			}
+			catch (...)
+			{}
+			throw;
+		}
+		try
+		{
+			l = f.get();
+		}
+		catch (...)
+		{
+			destroy_subtree(r);
+			throw;
+		}
+	}
 
-	inline node_pointer root(void) const noexcept
+	// the number of chunks the elements are split into, several per thread
+	// so that threads which finish early can take more
+	inline size_type chunk_count(size_type threads) const noexcept
 	{
-		return header->parent ? header->parent : header;
+		size_type count = size() / parallel_grain + 1;
+		if (threads == 1)
+			return 1;
+		return count < threads * 8 ? count : threads * 8;
 	}
 
-	inline node_pointer leftmost(node_pointer t) const noexcept
+	// calls task(c, idx, n) for each chunk c of count chunks, which holds the
+	// n elements from index idx on, and the threads take the chunks in turn
+	// from a shared counter
+	template <class Task>
+	void parallel_chunks(size_type count, size_type threads, Task task) const
 	{
-		while (t->left)
-			t = t->left;
-		return t;
+		size_type n = size();
+		std::atomic<size_type> next(0);
+		auto worker = [&]()
+		{
+			try
+			{
+				for (size_type c; (c = next.fetch_add(1)) < count;)
+					task(c, n * c / count, n * (c + 1) / count - n * c / count);
+			}
+			catch (...)
+			{
+				next.store(count);
+				throw;
+			}
+		};
+		std::vector<std::future<void>> workers;
+		std::exception_ptr error;
+		try
+		{
+			for (size_type i = 1; i < threads && i < count; ++i)
+				workers.push_back(std::async(std::launch::async, worker));
+			worker();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+			next.store(count);
+		}
+		for (auto& w : workers)
+		{
+			try
+			{
+				w.get();
+			}
+			catch (...)
+			{
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+		if (error)
+			std::rethrow_exception(error);
 	}
 
-	inline node_pointer rightmost(node_pointer t) const noexcept
+	// finds the nodes at the sorted indices in [lo, hi) in subtree t, whose
+	// first element is at index offset, and stores them from out on
+	void select_nodes(node_pointer t, size_type offset, const size_type* lo, const size_type* hi,
+		node_pointer* out, size_type threads) const
 	{
-		while (t->right)
+		while (t && lo != hi)
+		{
+			size_type k = offset + size_of(t->left);
+			const size_type* mid = std::lower_bound(lo, hi, k);
+			const size_type* next = std::upper_bound(mid, hi, k);
+			for (const size_type* p = mid; p != next; ++p)
+				out[p - lo] = t;
+			if (lo != mid)
+			{
+				if (threads > 1 && static_cast<size_type>(hi - lo) >= parallel_grain)
+				{
+					std::future<void> f = std::async(std::launch::async, [=]() { select_nodes(t->left, offset, lo, mid, out, threads / 2); });
+					select_nodes(t->right, k + 1, next, hi, out + (next - lo), threads - threads / 2);
+					f.get();
+					return;
+				}
+				select_nodes(t->left, offset, lo, mid, out, threads);
+			}
+			out += next - lo;
+			lo = next;
+			offset = k + 1;
 			t = t->right;
+		}
+	}
+
+	// returns the sums of the chunks from the first one to each chunk
+	template <class BinaryOp>
+	std::vector<value_type> chunk_sums(size_type count, size_type threads, BinaryOp& op) const
+	{
+		std::vector<value_type> sums(count, front());
+		// the last chunk is never needed
+		parallel_chunks(count, threads, [&](size_type c, size_type idx, size_type n)
+		{
+			if (c + 1 == count)
+				return;
+			const_iterator itr = select(idx);
+			value_type acc = *itr;
+			while (--n > 0)
+				acc = op(std::move(acc), *++itr);
+			sums[c] = std::move(acc);
+		});
+		for (size_type c = 1; c + 1 < count; ++c)
+			sums[c] = op(sums[c - 1], sums[c]);
+		return sums;
+	}
+
+	// links subtrees l and r under node t of n nodes
+	inline node_pointer link_children(node_pointer t, node_pointer l, node_pointer r, size_type n) noexcept
+	{
+		t->left = l;
+		t->right = r;
+		t->size = n;
+		if (l)
+			l->parent = t;
+		if (r)
+			r->parent = t;
 		return t;
 	}
 
-	inline void create_header(void)
+	// destroys a subtree that is not linked to the tree
+	void destroy_subtree(node_pointer t)
 	{
-		if (!header)
+		while (t)
 		{
-			header = this->create_node(value_type());
-			header->parent = nullptr;
-			header->left = header;
-			header->right = header;
-			header->size = 0;
+			node_pointer r = t->right;
+			destroy_subtree(t->left);
+			this->destroy_node(t);
+			t = r;
 		}
 	}
 
-	inline void destroy_header(void)
+	// copies subtree t of another ab-tree, forking while threads are left
+	node_pointer copy_subtree(const node_pointer t, size_type threads)
 	{
-		if (header)
+		if (!t)
+			return nullptr;
+		node_pointer l = nullptr;
+		node_pointer r = nullptr;
+		node_pointer n;
+		if (threads > 1 && t->size >= parallel_grain)
+			fork_nodes(l, r,
+				[this, t, threads]() { return copy_subtree(t->left, threads / 2); },
+				[this, t, threads]() { return copy_subtree(t->right, threads - threads / 2); });
+		else
+		{
+			l = copy_subtree(t->left, 1);
+			try
+			{
+				r = copy_subtree(t->right, 1);
+			}
+			catch (...)
+			{
+				destroy_subtree(l);
+				throw;
+			}
+		}
+		try
 		{
-			this->destroy_node(header);
-			header = nullptr;
+			n = this->create_node(t->value());
 		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			destroy_subtree(r);
+			throw;
+		}
+		return link_children(n, l, r, t->size);
+	}
+
+	// builds a perfectly balanced subtree of the n nodes from index offset
+	// on, node i is created by create(i), forking while threads are left
+	template <class Creator>
+	node_pointer build_subtree(size_type offset, size_type n, size_type threads, Creator& create)
+	{
+		if (n == 0)
+			return nullptr;
+		size_type left_size = (n - 1) / 2;
+		size_type right_size = n - 1 - left_size;
+		node_pointer l = nullptr;
+		node_pointer r = nullptr;
+		node_pointer t;
+		if (threads > 1 && n >= parallel_grain)
+			fork_nodes(l, r,
+				[&]() { return build_subtree(offset, left_size, threads / 2, create); },
+				[&]() { return build_subtree(offset + left_size + 1, right_size, threads - threads / 2, create); });
+		else
+		{
+			l = build_subtree(offset, left_size, 1, create);
+			try
+			{
+				r = build_subtree(offset + left_size + 1, right_size, 1, create);
+			}
+			catch (...)
+			{
+				destroy_subtree(l);
+				throw;
+			}
+		}
+		try
+		{
+			t = create(offset + left_size);
+		}
+		catch (...)
+		{
+			destroy_subtree(l);
+			destroy_subtree(r);
+			throw;
+		}
+		return link_children(t, l, r, n);
 	}
 
 	node_pointer select_node(size_type k) const noexcept
 	{
 		node_pointer t = header->parent;
+		ABT_STATISTIC(size_type steps = 0);
 		while (t)
 		{
-			size_type left_size = t->left ? t->left->size : 0;
-			if (left_size < k)
+			node_pointer l = t->left;
+			node_pointer r = t->right;
+			// fetches the right child while the size of the left one is loaded
+			ABT_PREFETCH(r);
+			size_type left_size = l ? l->size : 0;
+			ABT_STATISTIC(++steps);
+			if (k == left_size)
 			{
-				t = t->right;
-				k -= (left_size + 1);
-			}
-			else if (k < left_size)
-				t = t->left;
-			else
+				ABT_STATISTIC(counters.select(steps));
 				return t;
+			}
+			// picks the child by conditional moves rather than branches
+			bool right = left_size < k;
+			k -= right ? left_size + 1 : 0;
+			t = right ? r : l;
 		}
+		ABT_STATISTIC(counters.select(steps));
 		return header;
 	}
 
+	// the number of lookups that select_group interleaves
+	static constexpr size_type select_group_size = 16;
+
+	// finds the nodes at n indices, at most select_group_size, descending
+	// one level of each lookup in turn so that their cache misses overlap
+	void select_group(const size_type* indices, size_type n, node_pointer* out) const noexcept
+	{
+		node_pointer nodes[select_group_size];
+		size_type keys[select_group_size];
+		ABT_STATISTIC(size_type steps[select_group_size]);
+		for (size_type i = 0; i < n; ++i)
+		{
+			nodes[i] = header->parent;
+			keys[i] = indices[i];
+			out[i] = header;
+			ABT_STATISTIC(steps[i] = 0);
+		}
+		for (size_type live = n; live > 0;)
+		{
+			live = 0;
+			for (size_type i = 0; i < n; ++i)
+			{
+				node_pointer t = nodes[i];
+				if (!t)
+					continue;
+				node_pointer l = t->left;
+				size_type left_size = l ? l->size : 0;
+				ABT_STATISTIC(++steps[i]);
+				if (keys[i] == left_size)
+				{
+					out[i] = t;
+					nodes[i] = nullptr;
+					continue;
+				}
+				bool right = left_size < keys[i];
+				keys[i] -= right ? left_size + 1 : 0;
+				t = right ? t->right : l;
+				ABT_PREFETCH(t);
+				nodes[i] = t;
+				++live;
+			}
+		}
+		ABT_STATISTIC(for (size_type i = 0; i < n; ++i) counters.select(steps[i]));
+	}
+
+	// finds the nodes at the indices in [first, last) in groups
+	void select_groups(const size_type* first, const size_type* last, node_pointer* out) const noexcept
+	{
+		while (first != last)
+		{
+			size_type n = static_cast<size_type>(last - first);
+			if (n > select_group_size)
+				n = select_group_size;
+			select_group(first, n, out);
+			first += n;
+			out += n;
+		}
+	}
+
 	void copy_node(const node_pointer t)
 	{
 		bool flag = true;
 		node_pointer src = t;
 		node_pointer dst = header;
 		// copies the t node
-		node_pointer n = this->create_node(t->data);
+		node_pointer n = this->create_node(t->value());
 		n->parent = dst;
 		n->left = nullptr;
 		n->right = nullptr;
@@ -1044,7 +2672,7 @@ private:
 			{
 				src = src->left;
 				// copies the left child node
-				n = this->create_node(src->data);
+				n = this->create_node(src->value());
 				n->parent = dst;
 				n->left = nullptr;
 				n->right = nullptr;
@@ -1057,7 +2685,7 @@ private:
 			{
 				src = src->right;
 				// copies the right child node
-				n = this->create_node(src->data);
+				n = this->create_node(src->value());
 				n->parent = dst;
 				n->left = nullptr;
 				n->right = nullptr;
@@ -1070,7 +2698,7 @@ private:
 			{
 				src = src->parent->right;
 				// copies the sibling node
-				n = this->create_node(src->data);
+				n = this->create_node(src->value());
 				n->parent = dst->parent;
 				n->left = nullptr;
 				n->right = nullptr;
@@ -1093,10 +2721,15 @@ private:
 	}
 
 	template<class ...Args>
-	node_pointer insert_node(node_pointer t, Args&&... args)
+	inline node_pointer insert_node(node_pointer t, Args&&... args)
 	{
 		// creates a new node
-		node_pointer n = this->create_node(std::forward<Args>(args)...);
+		return link_node(t, this->create_node(std::forward<Args>(args)...));
+	}
+
+	// links the new node n before node t
+	node_pointer link_node(node_pointer t, node_pointer n)
+	{
 		n->left = nullptr;
 		n->right = nullptr;
 		n->size = 1;
@@ -1273,10 +2906,43 @@ private:
 		this->destroy_node(t);
 	}
 
-	void erase_root(void)
+	// erases n nodes starting from node t at index idx in O(n + log(size))
+	void erase_nodes(node_pointer t, size_type idx, size_type n)
+	{
+		if (n < 16)
+		{
+			// erasing a few nodes one by one is cheaper than split and join
+			for (; n > 0; --n)
+			{
+				node_pointer next = (++iterator(t)).get_pointer();
+				erase_node(t);
+				t = next;
+			}
+		}
+		else if (n == size())
+			clear();
+		else
+		{
+			// cuts the nodes out and joins the remaining parts
+			node_pointer l, m, r;
+			split_root(idx, l, r);
+			split_node(r, n, m, r);
+			erase_subtree(m);
+			link_root(concat_node(l, r));
+		}
+	}
+
+	inline void erase_root(void)
+	{
+		erase_subtree(header->parent);
+	}
+
+	// destroys subtree t in a linear walk
+	void erase_subtree(node_pointer t)
 	{
 		node_pointer next;
-		node_pointer cur = header->parent;
+		node_pointer cur = t;
+		node_pointer end = t->parent;
 		do
 		{
 			while (cur->left)
@@ -1293,11 +2959,12 @@ private:
 				this->destroy_node(cur);
 				cur = next;
 			}
-		} while (cur != header);
+		} while (cur != end);
 	}
 
 	node_pointer left_rotate(node_pointer t) const noexcept
 	{
+		ABT_STATISTIC(counters.rotate());
 		node_pointer r = t->right;
 		t->right = r->left;
 		if (r->left)
@@ -1318,6 +2985,7 @@ private:
 
 	node_pointer right_rotate(node_pointer t) const noexcept
 	{
+		ABT_STATISTIC(counters.rotate());
 		node_pointer l = t->left;
 		t->left = l->right;
 		if (l->right)
@@ -1338,6 +3006,7 @@ private:
 
 	node_pointer insert_rebalance(node_pointer t, bool flag)
 	{
+		ABT_STATISTIC(counters.enter_rebalance());
 		if (flag)
 		{
 			if (t->right)
@@ -1384,11 +3053,13 @@ private:
 				}
 			}
 		}
+		ABT_STATISTIC(counters.leave_rebalance());
 		return t;
 	}
 
 	node_pointer erase_rebalance(node_pointer t, bool flag)
 	{
+		ABT_STATISTIC(counters.enter_rebalance());
 		if (!flag)
 		{
 			if (t->right)
@@ -1435,11 +3106,199 @@ private:
 				}
 			}
 		}
+		ABT_STATISTIC(counters.leave_rebalance());
+		return t;
+	}
+
+	// restores the balance of t whose subtrees are ABTs but may differ greatly in size
+	node_pointer rebalance_node(node_pointer t)
+	{
+		size_type left_size = size_of(t->left);
+		size_type right_size = size_of(t->right);
+		if (t->right)
+		{
+			// case 1: size(T.left) < size(T.right.left)
+			if (t->right->left && left_size < t->right->left->size)
+			{
+				t->right = right_rotate(t->right);
+				t = left_rotate(t);
+				t->left = rebalance_node(t->left);
+				t->right = rebalance_node(t->right);
+				return rebalance_node(t);
+			}
+			// case 2. size(T.left) < size(T.right.right)
+			if (t->right->right && left_size < t->right->right->size)
+			{
+				t = left_rotate(t);
+				t->left = rebalance_node(t->left);
+				return rebalance_node(t);
+			}
+		}
+		if (t->left)
+		{
+			// case 3. size(T.right) < size(T.left.right)
+			if (t->left->right && right_size < t->left->right->size)
+			{
+				t->left = left_rotate(t->left);
+				t = right_rotate(t);
+				t->left = rebalance_node(t->left);
+				t->right = rebalance_node(t->right);
+				return rebalance_node(t);
+			}
+			// case 4. size(T.right) < size(T.left.left)
+			if (t->left->left && right_size < t->left->left->size)
+			{
+				t = right_rotate(t);
+				t->right = rebalance_node(t->right);
+				return rebalance_node(t);
+			}
+		}
 		return t;
 	}
 
+	// The split and join operations work on subtrees detached from the tree.
+	// While they run, the header is unlinked from the root and the roots of
+	// detached subtrees hang off the header, so rotations need no special case.
+
+	// joins subtree l, node m and subtree r in order, descending along the
+	// spine of the larger subtree until both sides are balanced
+	node_pointer join_node(node_pointer l, node_pointer m, node_pointer r)
+	{
+		node_pointer t;
+		if (l && (size_of(r) < size_of(l->left) || size_of(r) < size_of(l->right)))
+		{
+			t = join_node(l->right, m, r);
+			t->parent = l;
+			l->right = t;
+			l->size = size_of(l->left) + t->size + 1;
+			return rebalance_node(l);
+		}
+		if (r && (size_of(l) < size_of(r->left) || size_of(l) < size_of(r->right)))
+		{
+			t = join_node(l, m, r->left);
+			t->parent = r;
+			r->left = t;
+			r->size = t->size + size_of(r->right) + 1;
+			return rebalance_node(r);
+		}
+		m->parent = header;
+		m->left = l;
+		m->right = r;
+		m->size = size_of(l) + size_of(r) + 1;
+		if (l)
+			l->parent = m;
+		if (r)
+			r->parent = m;
+		return m;
+	}
+
+	// concatenates subtrees l and r, the last node of l joins them
+	node_pointer concat_node(node_pointer l, node_pointer r)
+	{
+		node_pointer a, m;
+		if (!l)
+			return r;
+		if (!r)
+			return l;
+		split_node(l, l->size - 1, a, m);
+		return join_node(a, m, r);
+	}
+
+	// splits subtree t into l holding its first k nodes and r holding the rest
+	void split_node(node_pointer t, size_type k, node_pointer& l, node_pointer& r)
+	{
+		if (!t)
+		{
+			l = nullptr;
+			r = nullptr;
+			return;
+		}
+		node_pointer a = t->left;
+		node_pointer b = t->right;
+		if (a)
+			a->parent = header;
+		if (b)
+			b->parent = header;
+		if (k <= size_of(a))
+		{
+			split_node(a, k, l, r);
+			r = join_node(r, t, b);
+		}
+		else
+		{
+			split_node(b, k - size_of(a) - 1, l, r);
+			l = join_node(a, t, l);
+		}
+	}
+
+	// applies the edits in [first, last) to detached subtree t, whose first
+	// element is at index offset, and takes the inserted nodes from next on
+	template <class ForwardIt>
+	node_pointer edit_subtree(node_pointer t, size_type offset, ForwardIt first, ForwardIt last, node_pointer*& next)
+	{
+		if (first == last)
+			return t;
+		if (!t)
+		{
+			// only inserts reach an empty subtree
+			auto create = [&]() { return *next++; };
+			t = build_node(static_cast<size_type>(std::distance(first, last)), create);
+			t->parent = header;
+			return t;
+		}
+		size_type k = offset + size_of(t->left);
+		// the edits before node t, including the inserts in front of it
+		ForwardIt mid = std::partition_point(first, last,
+			[k](const edit_type& e) { return e.index < k || (e.index == k && !e.erase); });
+		bool erased = mid != last && mid->index == k;
+		node_pointer a = t->left;
+		node_pointer b = t->right;
+		if (a)
+			a->parent = header;
+		if (b)
+			b->parent = header;
+		node_pointer l = edit_subtree(a, offset, first, mid, next);
+		node_pointer r = edit_subtree(b, k + 1, erased ? std::next(mid) : mid, last, next);
+		if (!erased)
+			return join_node(l, t, r);
+		this->destroy_node(t);
+		return concat_node(l, r);
+	}
+
+	// unlinks the root from the header and splits the tree at index k
+	void split_root(size_type k, node_pointer& l, node_pointer& r)
+	{
+		node_pointer t = header->parent;
+		header->parent = nullptr;
+		if (t)
+			t->parent = header;
+		split_node(t, k, l, r);
+	}
+
+	// links subtree t to the header as the whole tree
+	void link_root(node_pointer t)
+	{
+		header->parent = t;
+		if (t)
+		{
+			t->parent = header;
+			header->left = leftmost(t);
+			header->right = rightmost(t);
+		}
+		else
+		{
+			header->left = header;
+			header->right = header;
+		}
+	}
+
 private:
-	node_pointer header;
+	// the header lives in the tree, so an empty tree allocates nothing
+	ab_tree_node_links<T> head;
+	node_pointer          header;
+#ifdef ABT_STATISTICS
+	mutable ab_tree_counters counters;
+#endif // ABT_STATISTICS
 };
 
 #endif
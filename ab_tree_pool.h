@@ -0,0 +1,350 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+#pragma once
+
+#ifndef __RULER_AB_TREE_POOL_H__
+#define __RULER_AB_TREE_POOL_H__
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "define.h"
+
+#if defined(ABT_POOL_HUGE_PAGES) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// The size of a huge page, slabs are rounded up to it if huge pages are used.
+static constexpr size_t ab_tree_huge_page_size = 2 * 1024 * 1024;
+
+
+// Class ab_tree_pool
+// A pool of fixed-size blocks carved out of large slabs. Freed blocks are kept
+// in an intrusive free list, and all slabs can be released at once.
+class ab_tree_pool
+{
+public:
+	// construct/copy/destroy:
+
+	ab_tree_pool(size_t size, size_t align, size_t slab_size) noexcept
+		: block(round_up(size < sizeof(void*) ? sizeof(void*) : size, align < alignof(void*) ? alignof(void*) : align))
+		, offset(round_up(sizeof(void*), align < alignof(std::max_align_t) ? alignof(std::max_align_t) : align))
+		, slab(slab_size < offset + block ? offset + block : slab_size)
+		, slabs(nullptr)
+		, cursor(nullptr)
+		, last(nullptr)
+		, free_list(nullptr)
+	{
+#if defined(ABT_POOL_HUGE_PAGES) && defined(__linux__)
+		slab = round_up(slab, ab_tree_huge_page_size);
+#endif
+	}
+	ab_tree_pool(const ab_tree_pool&) = delete;
+	ab_tree_pool& operator=(const ab_tree_pool&) = delete;
+
+	~ab_tree_pool(void)
+	{
+		release();
+	}
+
+	// ab_tree_pool operations:
+
+	inline void* allocate(void)
+	{
+		void* p = free_list;
+		if (p)
+			free_list = *static_cast<void**>(p);
+		else
+		{
+			if (cursor == last)
+				grow();
+			p = cursor;
+			cursor += block;
+		}
+		return p;
+	}
+
+	inline void deallocate(void* p) noexcept
+	{
+		*static_cast<void**>(p) = free_list;
+		free_list = p;
+	}
+
+	// releases all slabs, the blocks allocated from them become invalid
+	void release(void) noexcept
+	{
+		while (slabs)
+		{
+			void* next = *static_cast<void**>(slabs);
+			free_slab(slabs);
+			slabs = next;
+		}
+		cursor = nullptr;
+		last = nullptr;
+		free_list = nullptr;
+	}
+
+	inline size_t block_size(void) const noexcept
+	{
+		return block;
+	}
+
+	inline size_t slab_size(void) const noexcept
+	{
+		return slab;
+	}
+
+private:
+
+	static constexpr size_t round_up(size_t n, size_t align) noexcept
+	{
+		return (n + align - 1) / align * align;
+	}
+
+	void grow(void)
+	{
+		char* p = static_cast<char*>(allocate_slab());
+		// the first bytes of a slab link it to the previous one
+		*reinterpret_cast<void**>(p) = slabs;
+		slabs = p;
+		cursor = p + offset;
+		last = cursor + (slab - offset) / block * block;
+	}
+
+	void* allocate_slab(void)
+	{
+#if defined(ABT_POOL_HUGE_PAGES) && defined(__linux__)
+		void* p = mmap(nullptr, slab, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+		madvise(p, slab, MADV_HUGEPAGE);
+#endif
+		return p;
+#else
+		return ::operator new(slab);
+#endif
+	}
+
+	void free_slab(void* p) noexcept
+	{
+#if defined(ABT_POOL_HUGE_PAGES) && defined(__linux__)
+		munmap(p, slab);
+#else
+		::operator delete(p);
+#endif
+	}
+
+private:
+	size_t block;
+	size_t offset;
+	size_t slab;
+	void*  slabs;
+	char*  cursor;
+	char*  last;
+	void*  free_list;
+};
+
+
+// Class ab_tree_pool_set
+// The pools of an allocator and of its copies and rebound copies, one for
+// each block size and alignment, made when a type first allocates.
+class ab_tree_pool_set
+{
+public:
+	// construct/copy/destroy:
+
+	ab_tree_pool_set(void) noexcept
+		: pools(nullptr)
+	{}
+	ab_tree_pool_set(const ab_tree_pool_set&) = delete;
+	ab_tree_pool_set& operator=(const ab_tree_pool_set&) = delete;
+
+	~ab_tree_pool_set(void)
+	{
+		while (pools)
+		{
+			entry* next = pools->next;
+			delete pools;
+			pools = next;
+		}
+	}
+
+	// ab_tree_pool_set operations:
+
+	// returns the pool of blocks of size bytes aligned to align
+	ab_tree_pool* get(size_t size, size_t align, size_t slab_size)
+	{
+		for (entry* e = pools; e; e = e->next)
+			if (e->size == size && e->align == align)
+				return &e->pool;
+		pools = new entry(size, align, slab_size, pools);
+		return &pools->pool;
+	}
+
+	// releases all slabs of all pools
+	void release(void) noexcept
+	{
+		for (entry* e = pools; e; e = e->next)
+			e->pool.release();
+	}
+
+private:
+	struct entry
+	{
+		entry(size_t n, size_t a, size_t slab_size, entry* p) noexcept
+			: pool(n, a, slab_size)
+			, size(n)
+			, align(a)
+			, next(p)
+		{}
+
+		ab_tree_pool pool;
+		size_t       size;
+		size_t       align;
+		entry*       next;
+	};
+
+	entry* pools;
+};
+
+
+// Class template ab_tree_pool_allocator
+// Single objects are allocated from a set of pools shared by the copies of
+// the allocator and by the allocators rebound from it, so these compare
+// equal and free each other's objects. Arrays fall back to the global
+// operator new. It is not thread-safe.
+template <class T, size_t SlabSize = 64 * 1024>
+class ab_tree_pool_allocator
+{
+	static_assert(alignof(T) <= alignof(std::max_align_t), "The pool of AB-Tree does not support over-aligned types.");
+
+	template <class U, size_t N>
+	friend class ab_tree_pool_allocator;
+
+public:
+	// types:
+
+	using value_type                             = T;
+	using pointer                                = T*;
+	using const_pointer                          = const T*;
+	using size_type                              = size_t;
+	using difference_type                        = ptrdiff_t;
+	using propagate_on_container_copy_assignment = std::false_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap            = std::true_type;
+
+	template <class U>
+	struct rebind
+	{
+		using other = ab_tree_pool_allocator<U, SlabSize>;
+	};
+
+	// construct/copy/destroy:
+
+	ab_tree_pool_allocator(void)
+		: pools(std::make_shared<ab_tree_pool_set>())
+		, pool(nullptr)
+	{}
+	ab_tree_pool_allocator(const ab_tree_pool_allocator<T, SlabSize>& other) noexcept
+		: pools(other.pools)
+		, pool(other.pool)
+	{}
+	template <class U>
+	ab_tree_pool_allocator(const ab_tree_pool_allocator<U, SlabSize>& other) noexcept
+		: pools(other.pools)
+		, pool(nullptr)
+	{}
+
+	inline ab_tree_pool_allocator<T, SlabSize>& operator=(const ab_tree_pool_allocator<T, SlabSize>& other) noexcept
+	{
+		pools = other.pools;
+		pool = other.pool;
+		return *this;
+	}
+
+	// ab_tree_pool_allocator operations:
+
+	inline T* allocate(size_t n)
+	{
+		if (n != 1)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		if (!pool)
+			pool = pools->get(sizeof(T), alignof(T), SlabSize);
+		return static_cast<T*>(pool->allocate());
+	}
+
+	inline void deallocate(T* p, size_t n) noexcept
+	{
+		if (n != 1)
+			::operator delete(p);
+		else
+		{
+			// the object may come from a copy that found the pool first
+			if (!pool)
+				pool = pools->get(sizeof(T), alignof(T), SlabSize);
+			pool->deallocate(p);
+		}
+	}
+
+	inline size_t max_size(void) const noexcept
+	{
+		return static_cast<size_t>(-1) / sizeof(T);
+	}
+
+	// releases all objects at once if no allocators but the given number of
+	// holders, such as the rebound copies kept by one container, share the pools
+	inline bool release(long holders = 1) noexcept
+	{
+		if (pools.use_count() > holders)
+			return false;
+		pools->release();
+		return true;
+	}
+
+	// relational operators:
+
+	template <class U>
+	inline bool operator==(const ab_tree_pool_allocator<U, SlabSize>& rhs) const noexcept
+	{
+		return pools == rhs.pools;
+	}
+
+	template <class U>
+	inline bool operator!=(const ab_tree_pool_allocator<U, SlabSize>& rhs) const noexcept
+	{
+		return !(*this == rhs);
+	}
+
+private:
+	std::shared_ptr<ab_tree_pool_set> pools;
+	ab_tree_pool*                     pool; // the pool of T in pools, found on first use
+};
+
+#endif
@@ -0,0 +1,526 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Compares ab_tree with std::vector, std::deque and std::list. Each result is
+// printed as a CSV row of container, element type, operation, size and the
+// nanoseconds per element or per operation, and may be checked against a
+// stored baseline:
+//
+//   ab_tree_benchmark [--sizes 1000,10000,100000] [--types int,payload,string]
+//                     [--large-sizes 1000000,10000000]
+//                     [--containers ab_tree,vector,deque,list] [--repeat 5]
+//                     [--output results.csv] [--baseline baseline.csv]
+//                     [--tolerance 0.5]
+//
+// The large sizes, beyond the caches, run for int only, and are dropped if
+// --sizes is given without --large-sizes.
+//
+// With a baseline, the ab_tree rows slower than the baseline by more than the
+// tolerance are reported on stderr and the exit code is 1. The baseline is
+// first scaled by how the std containers compare with it, which absorbs the
+// speed of the machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "ab_tree.h"
+
+// element types:
+
+struct payload
+{
+    int  key;
+    char bytes[60];
+};
+
+template <class T> struct element;
+
+template <>
+struct element<int>
+{
+    static const char* name(void) { return "int"; }
+    static int make(size_t i) { return static_cast<int>(i); }
+    static size_t key(int x) { return static_cast<size_t>(x); }
+};
+
+template <>
+struct element<payload>
+{
+    static const char* name(void) { return "payload"; }
+    static payload make(size_t i)
+    {
+        payload p;
+        p.key = static_cast<int>(i);
+        std::memset(p.bytes, static_cast<int>(i & 0x7F), sizeof(p.bytes));
+        return p;
+    }
+    static size_t key(const payload& x) { return static_cast<size_t>(x.key); }
+};
+
+template <>
+struct element<std::string>
+{
+    static const char* name(void) { return "string"; }
+    // longer than the small string buffer, so each element owns a heap block
+    static std::string make(size_t i) { return "element-of-the-benchmark-" + std::to_string(i); }
+    static size_t key(const std::string& x) { return x.size(); }
+};
+
+// container adapters:
+
+template <class C> struct container;
+
+template <class T>
+struct container<ab_tree<T>>
+{
+    static const char* name(void) { return "ab_tree"; }
+    static constexpr bool indexed = true;
+    static constexpr bool linear = false;
+    static typename ab_tree<T>::iterator position(ab_tree<T>& c, size_t i) { return c.select(i); }
+};
+
+template <class T>
+struct container<std::vector<T>>
+{
+    static const char* name(void) { return "vector"; }
+    static constexpr bool indexed = true;
+    static constexpr bool linear = true;
+    static typename std::vector<T>::iterator position(std::vector<T>& c, size_t i) { return c.begin() + static_cast<std::ptrdiff_t>(i); }
+};
+
+template <class T>
+struct container<std::deque<T>>
+{
+    static const char* name(void) { return "deque"; }
+    static constexpr bool indexed = true;
+    static constexpr bool linear = true;
+    static typename std::deque<T>::iterator position(std::deque<T>& c, size_t i) { return c.begin() + static_cast<std::ptrdiff_t>(i); }
+};
+
+template <class T>
+struct container<std::list<T>>
+{
+    static const char* name(void) { return "list"; }
+    static constexpr bool indexed = false;
+    static constexpr bool linear = true;
+    // walks from the nearer end
+    static typename std::list<T>::iterator position(std::list<T>& c, size_t i)
+    {
+        if (i <= c.size() / 2)
+            return std::next(c.begin(), static_cast<std::ptrdiff_t>(i));
+        return std::prev(c.end(), static_cast<std::ptrdiff_t>(c.size() - i));
+    }
+};
+
+template <class C, bool Indexed = container<C>::indexed>
+struct subscript
+{
+    static size_t get(C& c, size_t i) { return element<typename C::value_type>::key(c[i]); }
+};
+
+template <class C>
+struct subscript<C, false>
+{
+    static size_t get(C& c, size_t i) { return element<typename C::value_type>::key(*container<C>::position(c, i)); }
+};
+
+// primitive iterators only exist in ab_tree
+template <class C>
+struct primitive
+{
+    static constexpr bool exists = false;
+    static size_t walk(C&) { return 0; }
+};
+
+template <class T>
+struct primitive<ab_tree<T>>
+{
+    static constexpr bool exists = true;
+    static size_t walk(ab_tree<T>& c)
+    {
+        size_t sum = 0;
+        for (auto itr = c.pbegin(); itr != c.pend(); ++itr)
+            sum += element<T>::key(*itr);
+        return sum;
+    }
+};
+
+// measurement:
+
+struct options
+{
+    std::vector<size_t>      sizes = { 1000, 10000, 100000 };
+    std::vector<size_t>      large_sizes = { 1000000, 10000000 };
+    std::vector<std::string> types = { "int", "payload", "string" };
+    std::vector<std::string> containers = { "ab_tree", "vector", "deque", "list" };
+    size_t                   repeat = 5;
+    std::string              output;
+    std::string              baseline;
+    double                   tolerance = 0.5;
+};
+
+using result_key = std::tuple<std::string, std::string, std::string, size_t>;
+
+static volatile size_t sink;
+
+template <class Function>
+static double measure(Function f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the number of operations per measurement, fewer if each takes linear time,
+// and never more than n so that inserts at most double the container
+static size_t operations(size_t n, bool linear)
+{
+    size_t k = linear ? 10000000 / n : 100000;
+    return std::max<size_t>(10, std::min<size_t>({ k, n, 100000 }));
+}
+
+template <class C>
+class suite
+{
+public:
+    using value_type = typename C::value_type;
+    using traits = element<value_type>;
+    using adapter = container<C>;
+
+    suite(const options& opts, std::map<result_key, double>& results)
+        : opts(opts)
+        , results(results)
+    {}
+
+    void run(size_t n)
+    {
+        std::mt19937_64 rng(n);
+        size_t k = operations(n, false);
+        size_t kl = operations(n, adapter::linear);
+        std::vector<size_t> indices(std::min(k, kl));
+        for (auto& i : indices)
+            i = rng() % n;
+
+        record("select_random", n, indices.size(), [&](C& c)
+        {
+            size_t sum = 0;
+            for (size_t i : indices)
+                sum += traits::key(*adapter::position(c, i));
+            sink = sum;
+        }, false);
+        if (adapter::indexed)
+        {
+            record("index_random", n, indices.size(), [&](C& c)
+            {
+                size_t sum = 0;
+                for (size_t i : indices)
+                    sum += subscript<C>::get(c, i);
+                sink = sum;
+            }, false);
+            record("index_sequential", n, n, [&](C& c)
+            {
+                size_t sum = 0;
+                for (size_t i = 0; i < n; ++i)
+                    sum += subscript<C>::get(c, i);
+                sink = sum;
+            }, false);
+        }
+        modify("insert_front", n, kl, [](C&, size_t) { return size_t(0); }, true);
+        modify("insert_middle", n, kl, [](C& c, size_t) { return c.size() / 2; }, true);
+        modify("insert_back", n, k, [](C& c, size_t) { return c.size(); }, true);
+        modify("erase_front", n, kl, [](C&, size_t) { return size_t(0); }, false);
+        modify("erase_middle", n, kl, [](C& c, size_t) { return c.size() / 2; }, false);
+        modify("erase_back", n, k, [](C& c, size_t) { return c.size() - 1; }, false);
+
+        size_t m = std::max<size_t>(1, n / 10);
+        std::vector<value_type> src;
+        for (size_t i = 0; i < m; ++i)
+            src.push_back(traits::make(i));
+        record("insert_range", n, m, [&](C& c)
+        {
+            c.insert(adapter::position(c, c.size() / 2), src.begin(), src.end());
+        });
+        record("erase_range", n, m, [&](C& c)
+        {
+            auto first = adapter::position(c, (c.size() - m) / 2);
+            c.erase(first, std::next(first, static_cast<std::ptrdiff_t>(m)));
+        });
+
+        record("iterate", n, n, [&](C& c)
+        {
+            size_t sum = 0;
+            for (const auto& x : c)
+                sum += traits::key(x);
+            sink = sum;
+        }, false);
+        if (primitive<C>::exists)
+            record("iterate_primitive", n, n, [&](C& c) { sink = primitive<C>::walk(c); }, false);
+        record("copy", n, n, [&](C& c)
+        {
+            C copy(c);
+            sink = copy.size();
+        }, false);
+        record("clear", n, n, [&](C& c) { c.clear(); });
+    }
+
+private:
+
+    C build(size_t n)
+    {
+        C c;
+        for (size_t i = 0; i < n; ++i)
+            c.push_back(traits::make(i));
+        return c;
+    }
+
+    // times f on a container of n elements, rebuilt for each run if f
+    // modifies it, and keeps the fastest of the repeated runs divided by the
+    // count of elements or operations
+    template <class Function>
+    void record(const char* operation, size_t n, size_t count, Function f, bool modifies = true)
+    {
+        double best = 0;
+        C c;
+        for (size_t r = 0; r < opts.repeat; ++r)
+        {
+            if (r == 0 || modifies)
+                c = build(n);
+            double t = measure([&]() { f(c); });
+            if (r == 0 || t < best)
+                best = t;
+        }
+        double ns = best / static_cast<double>(count);
+        results[result_key(adapter::name(), traits::name(), operation, n)] = ns;
+        std::printf("%s,%s,%s,%zu,%.3f\n", adapter::name(), traits::name(), operation, n, ns);
+        std::fflush(stdout);
+    }
+
+    // inserts or erases k elements one by one at the positions given by pos
+    template <class Position>
+    void modify(const char* operation, size_t n, size_t k, Position pos, bool insert)
+    {
+        if (!insert)
+            k = std::min(k, n);
+        value_type value = traits::make(n);
+        record(operation, n, k, [&](C& c)
+        {
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (insert)
+                    c.insert(adapter::position(c, pos(c, i)), value);
+                else
+                    c.erase(adapter::position(c, pos(c, i)));
+            }
+        });
+    }
+
+private:
+    const options&                opts;
+    std::map<result_key, double>& results;
+};
+
+template <class T>
+static void run_type(const options& opts, const std::vector<size_t>& sizes, std::map<result_key, double>& results)
+{
+    auto selected = [&](const char* name)
+    {
+        return std::find(opts.containers.begin(), opts.containers.end(), name) != opts.containers.end();
+    };
+    for (size_t n : sizes)
+    {
+        if (selected("ab_tree"))
+            suite<ab_tree<T>>(opts, results).run(n);
+        if (selected("vector"))
+            suite<std::vector<T>>(opts, results).run(n);
+        if (selected("deque"))
+            suite<std::deque<T>>(opts, results).run(n);
+        if (selected("list"))
+            suite<std::list<T>>(opts, results).run(n);
+    }
+}
+
+// command line and results files:
+
+static std::vector<std::string> split(const std::string& s)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(s);
+    for (std::string part; std::getline(stream, part, ',');)
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+static std::vector<size_t> parse_sizes(const std::string& value)
+{
+    std::vector<size_t> sizes;
+    for (const auto& s : split(value))
+        sizes.push_back(static_cast<size_t>(std::stod(s)));
+    return sizes;
+}
+
+static bool parse(int argc, char* argv[], options& opts)
+{
+    bool large_sizes = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "--sizes")
+        {
+            opts.sizes = parse_sizes(value);
+            if (!large_sizes)
+                opts.large_sizes.clear();
+        }
+        else if (arg == "--large-sizes")
+        {
+            opts.large_sizes = parse_sizes(value);
+            large_sizes = true;
+        }
+        else if (arg == "--types")
+            opts.types = split(value);
+        else if (arg == "--containers")
+            opts.containers = split(value);
+        else if (arg == "--repeat")
+            opts.repeat = std::max<size_t>(1, std::stoul(value));
+        else if (arg == "--output")
+            opts.output = value;
+        else if (arg == "--baseline")
+            opts.baseline = value;
+        else if (arg == "--tolerance")
+            opts.tolerance = std::stod(value);
+        else
+            return false;
+    }
+    return true;
+}
+
+static std::map<result_key, double> load(const std::string& path)
+{
+    std::map<result_key, double> rows;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> cells = split(line);
+        if (cells.size() == 5)
+            rows[result_key(cells[0], cells[1], cells[2], std::stoull(cells[3]))] = std::stod(cells[4]);
+    }
+    return rows;
+}
+
+static void save(const std::string& path, const std::map<result_key, double>& rows)
+{
+    std::ofstream file(path);
+    file << "container,type,operation,size,ns\n";
+    for (const auto& row : rows)
+        file << std::get<0>(row.first) << ',' << std::get<1>(row.first) << ',' << std::get<2>(row.first) << ','
+            << std::get<3>(row.first) << ',' << row.second << '\n';
+}
+
+// reports the ab_tree results slower than the baseline beyond the tolerance,
+// after scaling the baseline by how much faster or slower the std containers
+// ran than in it, so that a baseline from another machine stays usable
+static int compare(const std::map<result_key, double>& results, const std::map<result_key, double>& baseline, double tolerance)
+{
+    double log_sum = 0;
+    size_t log_count = 0;
+    for (const auto& row : results)
+    {
+        auto itr = baseline.find(row.first);
+        if (std::get<0>(row.first) != "ab_tree" && itr != baseline.end() && row.second > 0.1 && itr->second > 0.1)
+        {
+            log_sum += std::log(row.second / itr->second);
+            ++log_count;
+        }
+    }
+    double scale = log_count > 0 ? std::exp(log_sum / static_cast<double>(log_count)) : 1;
+
+    int regressions = 0;
+    for (const auto& row : results)
+    {
+        auto itr = baseline.find(row.first);
+        if (std::get<0>(row.first) != "ab_tree" || itr == baseline.end())
+            continue;
+        if (row.second > itr->second * scale * (1 + tolerance))
+        {
+            std::fprintf(stderr, "regression: %s,%s,%zu: %.3f ns, baseline %.3f ns scaled to %.3f ns\n", std::get<1>(row.first).c_str(),
+                std::get<2>(row.first).c_str(), std::get<3>(row.first), row.second, itr->second, itr->second * scale);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+    options opts;
+    if (!parse(argc, argv, opts))
+    {
+        std::fprintf(stderr, "usage: %s [--sizes n,...] [--large-sizes n,...] [--types int,payload,string] [--containers ab_tree,vector,deque,list]"
+            " [--repeat r] [--output file] [--baseline file] [--tolerance t]\n", argv[0]);
+        return 2;
+    }
+
+    std::map<result_key, double> results;
+    std::printf("container,type,operation,size,ns\n");
+    for (const auto& type : opts.types)
+    {
+        if (type == "int")
+            run_type<int>(opts, opts.sizes, results);
+        else if (type == "payload")
+            run_type<payload>(opts, opts.sizes, results);
+        else if (type == "string")
+            run_type<std::string>(opts, opts.sizes, results);
+    }
+    if (std::find(opts.types.begin(), opts.types.end(), "int") != opts.types.end())
+        run_type<int>(opts, opts.large_sizes, results);
+
+    if (!opts.output.empty())
+        save(opts.output, results);
+    if (!opts.baseline.empty() && compare(results, load(opts.baseline), opts.tolerance) > 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Measures the throughput of ab_concurrent_tree against an ab_tree behind one
+// mutex, at 1 to 64 threads doing random lookups, insertions and deletions.
+// Pass the number of elements, the total number of operations, the percentage
+// of lookups and the largest number of threads as arguments. Prints one CSV
+// row of container, threads, lookup percentage and operations per second for
+// each run. The speedup is bounded by the cores of the machine.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ab_concurrent_tree.h"
+
+static std::atomic<long long> sink;
+
+// the baseline, every operation under one lock
+class locked_tree
+{
+public:
+    template <class InputIt>
+    locked_tree(InputIt first, InputIt last)
+        : tree(first, last)
+    {}
+
+    template <class Function>
+    bool visit(size_t idx, Function f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idx >= tree.size())
+            return false;
+        f(tree[idx]);
+        return true;
+    }
+
+    void insert(size_t idx, int value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tree.insert(idx < tree.size() ? idx : tree.size(), value);
+    }
+
+    bool erase(size_t idx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idx >= tree.size())
+            return false;
+        tree.erase(idx);
+        return true;
+    }
+
+private:
+    std::mutex   mutex;
+    ab_tree<int> tree;
+};
+
+// runs ops operations split between the threads, half of the others
+// insertions and half deletions, so the size stays around n
+template <class Tree>
+static double run(size_t n, size_t ops, unsigned reads, size_t threads)
+{
+    std::vector<int> values(n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = static_cast<int>(i);
+    Tree tree(values.begin(), values.end());
+
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t)
+        workers.emplace_back([&, t]()
+        {
+            std::mt19937_64 rng(t + 1);
+            long long sum = 0;
+            for (size_t i = ops * t / threads; i < ops * (t + 1) / threads; ++i)
+            {
+                size_t idx = rng() % n;
+                unsigned op = static_cast<unsigned>(rng() % 100);
+                if (op < reads)
+                    tree.visit(idx, [&](int x) { sum += x; });
+                else if ((op - reads) % 2 == 0)
+                    tree.insert(idx, static_cast<int>(i));
+                else
+                    tree.erase(idx);
+            }
+            sink += sum;
+        });
+    for (auto& w : workers)
+        w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(ops) / seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+    unsigned reads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 50;
+    size_t max_threads = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 64;
+
+    std::printf("container,threads,reads,ops_per_second\n");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        std::printf("locked,%zu,%u,%.0f\n", threads, reads, run<locked_tree>(n, ops, reads, threads));
+        std::printf("concurrent,%zu,%u,%.0f\n", threads, reads, run<ab_concurrent_tree<int>>(n, ops, reads, threads));
+        std::fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Measures indexed access on trees larger than the last level cache. Build it
+// with optimizations, e.g. g++ -std=c++17 -O2 -pthread -I.. select_benchmark.cpp,
+// and pass the number of elements and of lookups as arguments.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include "ab_tree.h"
+
+template <class Function>
+static double measure(Function f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void run(const char* name, const ab_tree<int>& tree, const std::vector<size_t>& indices)
+{
+    std::vector<size_t> sorted(indices);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<int> out;
+    out.reserve(indices.size());
+    long long sum = 0;
+
+    double single = measure([&]()
+    {
+        for (size_t idx : indices)
+            sum += tree[idx];
+    });
+    double grouped = measure([&]()
+    {
+        tree.multi_select(indices.begin(), indices.end(), std::back_inserter(out));
+    });
+    for (int x : out)
+        sum -= x;
+    out.clear();
+    double shared = measure([&]()
+    {
+        tree.multi_select(sorted.begin(), sorted.end(), std::back_inserter(out));
+    });
+
+    double n = static_cast<double>(indices.size());
+    std::printf("%-10s operator[] %7.1f ns  multi_select %7.1f ns  sorted multi_select %7.1f ns  (%lld)\n",
+        name, single * 1e9 / n, grouped * 1e9 / n, shared * 1e9 / n, sum);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t k = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+    std::mt19937_64 rng(1);
+
+    std::vector<size_t> indices(k);
+    for (auto& idx : indices)
+        idx = rng() % n;
+
+    // nodes allocated in index order
+    {
+        ab_tree<int> tree = ab_tree<int>::parallel_generate(n, [](size_t i) { return static_cast<int>(i); });
+        run("built", tree, indices);
+    }
+
+    // nodes scattered over the heap by random insertions
+    {
+        ab_tree<int> tree;
+        for (size_t i = 0; i < n; ++i)
+            tree.insert(rng() % (tree.size() + 1), static_cast<int>(i));
+        run("scattered", tree, indices);
+    }
+
+    return 0;
+}
@@ -32,11 +32,43 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cstdint>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#endif
+
+// hints the cache to fetch the node at address p
+#if defined(__GNUC__) || defined(__clang__)
+#define ABT_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER)
+#define ABT_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0)
+#else
+#define ABT_PREFETCH(p) ((void)0)
+#endif
+
+// counts the work of rotations, rebalancing and lookups in ab_tree if
+// ABT_STATISTICS is defined, and compiles to nothing otherwise
+#ifdef ABT_STATISTICS
+#define ABT_STATISTIC(...) __VA_ARGS__
+#else
+#define ABT_STATISTIC(...)
+#endif
+
 // domain_error
-static constexpr char ABT_IS_INITIALIZED[]  = "The AB-Tree is initialized.";
-static constexpr char ABT_NOT_INITIALIZED[] = "The AB-Tree is not initialized.";
+static constexpr char ABT_IS_INITIALIZED[]   = "The AB-Tree is initialized.";
+static constexpr char ABT_NOT_INITIALIZED[]  = "The AB-Tree is not initialized.";
 
 // out_of_range
-static constexpr char ABT_OUT_OF_RANGE[]    = "The index of AB-Tree is out of range.";
+static constexpr char ABT_OUT_OF_RANGE[]     = "The index of AB-Tree is out of range.";
+
+// invalid_argument
+static constexpr char ABT_UNSORTED_EDITS[]   = "The edits of AB-Tree are not sorted by index.";
+
+// length_error
+static constexpr char ABT_TOO_LONG[]         = "The AB-Tree is too long.";
+static constexpr char ABT_TOO_MANY_READERS[] = "The AB-Tree has too many readers.";
+
+// ios_base::failure
+static constexpr char ABT_BAD_STREAM[]       = "The stream does not hold a saved AB-Tree.";
+static constexpr char ABT_STREAM_FAILED[]    = "The stream of AB-Tree failed.";
 
 #endif
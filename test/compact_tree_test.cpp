@@ -0,0 +1,164 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks that ab_compact_tree reads the inserted value before the arena it
+// may live in is reallocated, that a moved-from tree stays usable, and that
+// a range insertion that throws destroys the elements it made.
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ab_compact_tree.h"
+#include "test.h"
+
+template <class T, class Make>
+static void check_self_insertion(Make make)
+{
+	ab_compact_tree<T> tree;
+	std::vector<T> expected;
+	// every insertion that fills the arena copies an element of the tree
+	for (int i = 0; i < 300; ++i)
+	{
+		if (i == 0)
+		{
+			tree.push_back(make(0));
+			expected.push_back(make(0));
+		}
+		else if (i % 3 == 0)
+		{
+			tree.push_back(tree[0]);
+			expected.push_back(expected[0]);
+		}
+		else if (i % 3 == 1)
+		{
+			tree.insert(tree.size() / 2, tree[tree.size() - 1]);
+			expected.insert(expected.begin() + expected.size() / 2, expected.back());
+		}
+		else
+		{
+			tree.push_front(make(i));
+			expected.insert(expected.begin(), make(i));
+		}
+	}
+	tree.insert(tree.cbegin() + 1, tree.size(), tree[0]);
+	expected.insert(expected.begin() + 1, expected.size(), expected[0]);
+	REQUIRE(tree.size() == expected.size());
+	for (size_t i = 0; i < expected.size(); ++i)
+		REQUIRE(tree[i] == expected[i]);
+}
+
+static int live = 0;
+static int copies_left = -1;
+
+// an element whose copy throws once copies_left reaches zero
+struct element
+{
+	int value;
+
+	explicit element(int v)
+		: value(v)
+	{
+		++live;
+	}
+	element(const element& other)
+		: value(other.value)
+	{
+		if (copies_left == 0)
+			throw std::runtime_error("copy");
+		if (copies_left > 0)
+			--copies_left;
+		++live;
+	}
+	element(element&& other) noexcept
+		: value(other.value)
+	{
+		++live;
+	}
+	~element(void)
+	{
+		--live;
+	}
+};
+
+static void check_throwing_range(void)
+{
+	std::vector<element> source;
+	for (int i = 0; i < 10; ++i)
+		source.emplace_back(i);
+	int before = live;
+	for (int fail : { 0, 1, 5, 9 })
+	{
+		ab_compact_tree<element> tree;
+		copies_left = fail;
+		bool thrown = false;
+		try
+		{
+			tree.insert(tree.cend(), source.begin(), source.end());
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		copies_left = -1;
+		REQUIRE(thrown && tree.empty() && live == before);
+		tree.insert(tree.cend(), source.begin(), source.end());
+		REQUIRE(tree.size() == 10 && live == before + 10);
+		for (int i = 0; i < 10; ++i)
+			REQUIRE(tree[i].value == i);
+	}
+	REQUIRE(live == before);
+}
+
+static void check_moved_from(void)
+{
+	ab_compact_tree<int> a{ 1, 2, 3 };
+	ab_compact_tree<int> b(std::move(a));
+	REQUIRE(b.size() == 3 && b[2] == 3);
+	REQUIRE(a.empty() && a.size() == 0 && a.begin() == a.end());
+	a.clear();
+	for (int i = 0; i < 100; ++i)
+		a.push_back(i);
+	REQUIRE(a.size() == 100 && a[99] == 99);
+	b = std::move(a);
+	REQUIRE(b.size() == 100);
+	a.push_back(7);
+	REQUIRE(a.back() == 7);
+}
+
+int main(void)
+{
+	check_self_insertion<int>([](int i) { return i; });
+	check_self_insertion<std::string>([](int i) { return std::string(40, static_cast<char>('a' + i % 26)); });
+	check_moved_from();
+	check_throwing_range();
+	std::puts("ok");
+	return 0;
+}
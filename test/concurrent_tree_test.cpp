@@ -0,0 +1,177 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks ab_concurrent_tree against the operations recorded by many threads
+// inserting, erasing, visiting and modifying at once, with a small shard size
+// so that shards are split and merged all the time.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ab_concurrent_tree.h"
+#include "test.h"
+
+struct item
+{
+	int id;
+	int hits;
+};
+
+static const int threads = 8;
+static const int per_thread = 2000;
+
+// runs f(t) on threads threads at once
+template <class Function>
+static void run(Function f)
+{
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; ++t)
+		pool.emplace_back(f, t);
+	for (std::thread& th : pool)
+		th.join();
+}
+
+static std::vector<item> contents(const ab_concurrent_tree<item>& tree)
+{
+	std::vector<item> v;
+	tree.for_each([&](const item& x) { v.push_back(x); });
+	REQUIRE(v.size() == tree.size());
+	return v;
+}
+
+// checks that the ids are distinct and that the ids t * per_thread + i made
+// by the loop of thread t keep the order of order[t]: increasing if they
+// were appended, decreasing if they were prepended, any if they were inserted
+static void check_order(const std::vector<item>& v, const std::vector<int>& order)
+{
+	std::vector<int> last(order.size(), -1);
+	std::vector<bool> seen(order.size() * per_thread, false);
+	for (const item& x : v)
+	{
+		REQUIRE(x.id >= 0 && x.id < static_cast<int>(seen.size()) && !seen[x.id]);
+		seen[x.id] = true;
+		int t = x.id / per_thread;
+		int i = x.id % per_thread;
+		if (order[t] != 0)
+		{
+			REQUIRE(last[t] < 0 || (order[t] > 0 ? i > last[t] : i < last[t]));
+			last[t] = i;
+		}
+	}
+}
+
+int main(void)
+{
+	ab_concurrent_tree<item> tree(8);
+	// thread t appends, prepends or inserts at random indices
+	// the second half of the ids are inserted later at random
+	std::vector<int> order(2 * threads, 0);
+	for (int t = 0; t < threads; ++t)
+		order[t] = t % 3 == 0 ? 1 : t % 3 == 1 ? -1 : 0;
+
+	run([&](int t)
+	{
+		std::mt19937 gen(t);
+		for (int i = 0; i < per_thread; ++i)
+		{
+			item x{ t * per_thread + i, 0 };
+			if (order[t] > 0)
+				tree.push_back(x);
+			else if (order[t] < 0)
+				tree.push_front(x);
+			else
+				tree.insert(gen() % (tree.size() + 1), x);
+		}
+	});
+	REQUIRE(tree.size() == static_cast<size_t>(threads * per_thread));
+	REQUIRE(tree.shard_count() > 1);
+	std::vector<item> v = contents(tree);
+	check_order(v, order);
+	for (const item& x : v)
+		REQUIRE(x.id < threads * per_thread);
+
+	// modifications and visits do not change the size, so each one succeeds
+	run([&](int t)
+	{
+		std::mt19937 gen(threads + t);
+		for (int i = 0; i < per_thread; ++i)
+		{
+			size_t idx = gen() % (threads * per_thread);
+			REQUIRE(tree.modify(idx, [](item& x) { ++x.hits; }));
+			REQUIRE(tree.visit(gen() % (threads * per_thread), [](const item& x) { REQUIRE(x.hits >= 0); }));
+		}
+	});
+	v = contents(tree);
+	long hits = 0;
+	for (const item& x : v)
+		hits += x.hits;
+	REQUIRE(hits == static_cast<long>(threads) * per_thread);
+
+	// half the threads erase at random while the others insert new ids
+	std::atomic<long> erased(0);
+	run([&](int t)
+	{
+		std::mt19937 gen(2 * threads + t);
+		for (int i = 0; i < per_thread; ++i)
+		{
+			if (t % 2 == 0)
+			{
+				if (tree.erase(gen() % (tree.size() + 1)))
+					++erased;
+			}
+			else
+				tree.insert(gen() % (tree.size() + 1), item{ threads * per_thread + t * per_thread + i, 0 });
+		}
+	});
+	size_t inserted = static_cast<size_t>(threads / 2) * per_thread;
+	REQUIRE(tree.size() == threads * per_thread + inserted - erased);
+	v = contents(tree);
+	check_order(v, order);
+	hits = 0;
+	for (const item& x : v)
+		hits += x.hits;
+	REQUIRE(hits <= static_cast<long>(threads) * per_thread);
+
+	// erasing nearly everything merges the shards again
+	run([&](int)
+	{
+		while (tree.size() > 4)
+			tree.erase(0);
+	});
+	REQUIRE(tree.size() <= 4 && tree.shard_count() <= 4);
+	v = contents(tree);
+	check_order(v, order);
+	tree.clear();
+	REQUIRE(tree.empty() && tree.shard_count() == 1);
+
+	std::puts("ok");
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks that ab_tree releases every node it made when an element copy
+// throws in the middle of building a subtree.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+#include "ab_tree.h"
+#include "ab_persistent_tree.h"
+#include "test.h"
+
+static int live_nodes = 0;
+static int copies_left = -1;
+
+// an element whose copy throws once copies_left reaches zero
+struct element
+{
+	int value;
+
+	explicit element(int v)
+		: value(v)
+	{}
+	element(const element& other)
+		: value(other.value)
+	{
+		if (copies_left == 0)
+			throw std::runtime_error("copy");
+		if (copies_left > 0)
+			--copies_left;
+	}
+	element& operator=(const element&) = default;
+};
+
+template <class T>
+struct counting_allocator
+{
+	using value_type = T;
+
+	counting_allocator(void) = default;
+	template <class U>
+	counting_allocator(const counting_allocator<U>&) noexcept
+	{}
+
+	T* allocate(size_t n)
+	{
+		++live_nodes;
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T* p, size_t n) noexcept
+	{
+		--live_nodes;
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template <class U>
+	bool operator==(const counting_allocator<U>&) const noexcept
+	{
+		return true;
+	}
+	template <class U>
+	bool operator!=(const counting_allocator<U>&) const noexcept
+	{
+		return false;
+	}
+};
+
+using tree_type = ab_tree<element, counting_allocator<element>>;
+
+static void require_values(const tree_type& tree, int n)
+{
+	REQUIRE(static_cast<int>(tree.size()) == n);
+	int i = 0;
+	for (const element& x : tree)
+		REQUIRE(x.value == i++);
+	REQUIRE(live_nodes == n);
+}
+
+int main(void)
+{
+	std::vector<element> source;
+	for (int i = 0; i < 100; ++i)
+		source.emplace_back(i);
+
+	// the range constructor
+	for (int fail : { 0, 1, 50, 99 })
+	{
+		copies_left = fail;
+		try
+		{
+			tree_type tree(source.begin(), source.end());
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		copies_left = -1;
+		REQUIRE(live_nodes == 0);
+	}
+
+	// the fill constructor and generate
+	for (int fail : { 0, 1, 50, 99 })
+	{
+		copies_left = fail;
+		try
+		{
+			tree_type tree(100, element(7));
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		copies_left = -1;
+		REQUIRE(live_nodes == 0);
+		int made = 0;
+		try
+		{
+			tree_type tree = tree_type::generate(100, [&]()
+			{
+				if (made == fail)
+					throw std::runtime_error("generate");
+				return element(made++);
+			});
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		REQUIRE(live_nodes == 0);
+	}
+
+	// inserting a range into a non-empty tree
+	for (int fail : { 0, 1, 45, 89 })
+	{
+		tree_type tree(source.begin(), source.begin() + 10);
+		copies_left = fail;
+		try
+		{
+			tree.insert(tree.cend(), source.begin() + 10, source.end());
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		copies_left = -1;
+		require_values(tree, 10);
+	}
+
+	// assign leaves the tree empty
+	{
+		tree_type tree(source.begin(), source.end());
+		copies_left = 40;
+		try
+		{
+			tree.assign(source.begin(), source.end());
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		copies_left = -1;
+		require_values(tree, 0);
+	}
+
+	// a persistent insertion whose path copy throws keeps both versions
+	{
+		using persistent_type = ab_persistent_tree<element, counting_allocator<element>>;
+		persistent_type tree(source.begin(), source.end());
+		persistent_type version(tree);
+		copies_left = 1;
+		try
+		{
+			tree.insert(50, element(-1));
+			REQUIRE(false);
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		copies_left = -1;
+		REQUIRE(tree.size() == 100 && version.size() == 100);
+		// reads through const references, which copy nothing
+		const persistent_type& a = tree;
+		const persistent_type& b = version;
+		for (int i = 0; i < 100; ++i)
+			REQUIRE(a[i].value == i && b[i].value == i);
+		REQUIRE(live_nodes == 100);
+	}
+
+	REQUIRE(live_nodes == 0);
+	std::puts("ok");
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks the sums, prefix searches and lazy range updates of ab_monoid_tree
+// against a std::vector, for each monoid with each action.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "ab_monoid_tree.h"
+#include "test.h"
+
+using value = long long;
+
+// the monotone predicates of find_prefix, true from some prefix on
+static bool reached(const ab_tree_sum<value>&, value sum, value threshold)
+{
+	return sum >= threshold;
+}
+static bool reached(const ab_tree_min<value>&, value sum, value threshold)
+{
+	return sum <= threshold;
+}
+static bool reached(const ab_tree_max<value>&, value sum, value threshold)
+{
+	return sum >= threshold;
+}
+
+// applies a range update to the tree and to the model, tags keep the
+// elements non-negative so that the prefix sums grow
+template <class Tree, class Monoid>
+static void update(Tree& tree, std::vector<value>& model, size_t first, size_t last, value tag, ab_tree_add<Monoid>)
+{
+	tree.update(first, last, tag);
+	for (size_t i = first; i < last && i < model.size(); ++i)
+		model[i] += tag;
+}
+template <class Tree, class Monoid>
+static void update(Tree& tree, std::vector<value>& model, size_t first, size_t last, value tag, ab_tree_assign<Monoid>)
+{
+	tree.update(first, last, tag);
+	for (size_t i = first; i < last && i < model.size(); ++i)
+		model[i] = tag;
+}
+template <class Tree>
+static void update(Tree&, std::vector<value>&, size_t, size_t, value, ab_tree_no_action)
+{}
+
+template <class Tree>
+static void check_equal(const Tree& tree, const std::vector<value>& model)
+{
+	REQUIRE(tree.size() == model.size());
+	size_t i = 0;
+	for (value x : tree)
+		REQUIRE(x == model[i++]);
+	for (size_t j = 0; j < model.size(); ++j)
+		REQUIRE(tree[j] == model[j]);
+}
+
+template <class Monoid, class Action>
+static void check_model(unsigned seed)
+{
+	using tree_type = ab_monoid_tree<value, Monoid, Action>;
+	tree_type tree;
+	std::vector<value> model;
+	Monoid monoid;
+	std::mt19937 gen(seed);
+	auto fold = [&](size_t first, size_t last)
+	{
+		value sum = monoid.identity();
+		for (size_t i = first; i < last; ++i)
+			sum = monoid.combine(sum, monoid.lift(model[i]));
+		return sum;
+	};
+	for (int step = 0; step < 4000; ++step)
+	{
+		size_t n = model.size();
+		size_t idx = gen() % (n + 1);
+		value x = static_cast<value>(gen() % 100);
+		switch (gen() % 8)
+		{
+		case 0:
+		case 1:
+			tree.insert(idx, x);
+			model.insert(model.begin() + idx, x);
+			break;
+		case 2:
+			if (idx < n)
+			{
+				tree.erase(idx);
+				model.erase(model.begin() + idx);
+			}
+			break;
+		case 3:
+			if (idx < n)
+			{
+				tree.set(idx, x);
+				model[idx] = x;
+			}
+			break;
+		case 4:
+			if (idx < n)
+			{
+				tree.modify(idx, [](value& y) { y += 3; });
+				model[idx] += 3;
+			}
+			break;
+		case 5:
+			update(tree, model, idx, idx + gen() % (n + 2), x % 10, Action());
+			break;
+		case 6:
+		{
+			size_t last = idx + gen() % (n + 2);
+			REQUIRE(tree.reduce(idx, last) == fold(idx, last < n ? last : n));
+			REQUIRE(tree.reduce() == fold(0, n));
+			break;
+		}
+		default:
+		{
+			value threshold = static_cast<value>(gen() % (n * 20 + 100));
+			size_t expected = 0;
+			value sum = monoid.identity();
+			for (; expected < n; ++expected)
+			{
+				sum = monoid.combine(sum, monoid.lift(model[expected]));
+				if (reached(monoid, sum, threshold))
+					break;
+			}
+			REQUIRE(tree.find_prefix([&](value s) { return reached(monoid, s, threshold); }) == expected);
+			break;
+		}
+		}
+		if (step % 500 == 0)
+			check_equal(tree, model);
+	}
+	check_equal(tree, model);
+	tree_type copy(tree);
+	check_equal(copy, model);
+	REQUIRE(copy.reduce() == fold(0, model.size()));
+}
+
+template <class Monoid>
+static void check_monoid(unsigned seed)
+{
+	check_model<Monoid, ab_tree_no_action>(seed);
+	check_model<Monoid, ab_tree_add<Monoid>>(seed + 1);
+	check_model<Monoid, ab_tree_assign<Monoid>>(seed + 2);
+}
+
+int main(void)
+{
+	check_monoid<ab_tree_sum<value>>(1);
+	check_monoid<ab_tree_min<value>>(11);
+	check_monoid<ab_tree_max<value>>(21);
+	std::puts("ok");
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks ab_paged_tree against std::vector with a cache of a few pages, so
+// that pages are replaced and written back all the time.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "ab_paged_tree.h"
+#include "test.h"
+
+static const char filename[] = "ab_paged_tree_test.bin";
+
+template <class Tree>
+static void require_equal(const Tree& tree, const std::vector<int>& expected)
+{
+	REQUIRE(tree.size() == expected.size());
+	size_t i = 0;
+	for (int x : tree)
+		REQUIRE(x == expected[i++]);
+	REQUIRE(i == expected.size());
+}
+
+int main(void)
+{
+	std::mt19937 rng(1);
+	ab_paged_tree<int, 64> tree(filename, 4);
+	std::vector<int> expected;
+
+	// indices past the end append or do nothing, as in ab_tree
+	tree.pop_back();
+	tree.pop_front();
+	REQUIRE(tree.erase(0) == tree.end());
+	tree.insert(5, 1);
+	expected.push_back(1);
+	REQUIRE(tree.erase(1) == tree.end());
+	require_equal(tree, expected);
+
+	for (int i = 0; i < 20000; ++i)
+	{
+		unsigned op = rng() % 10;
+		if (op < 5 || expected.empty())
+		{
+			size_t idx = rng() % (expected.size() + 1);
+			int x = static_cast<int>(rng());
+			REQUIRE(*tree.insert(idx, x) == x);
+			expected.insert(expected.begin() + idx, x);
+		}
+		else if (op < 8)
+		{
+			size_t idx = rng() % expected.size();
+			tree.erase(idx);
+			expected.erase(expected.begin() + idx);
+		}
+		else
+		{
+			size_t idx = rng() % expected.size();
+			int x = static_cast<int>(rng());
+			tree.set(idx, x);
+			expected[idx] = x;
+		}
+		if (i % 1000 == 0)
+		{
+			require_equal(tree, expected);
+			for (size_t j = 0; j < expected.size(); j += 7)
+				REQUIRE(tree[j] == expected[j] && *tree.select(j) == expected[j]);
+			tree.flush();
+		}
+	}
+	require_equal(tree, expected);
+
+	while (!expected.empty())
+	{
+		tree.pop_back();
+		expected.pop_back();
+	}
+	REQUIRE(tree.empty() && tree.page_count() == 1);
+	std::remove(filename);
+	std::puts("ok");
+	return 0;
+}
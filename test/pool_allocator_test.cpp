@@ -0,0 +1,138 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks that the copies and rebound copies of ab_tree_pool_allocator share
+// their pools and compare equal from the start.
+
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <type_traits>
+#include "ab_tree_pool.h"
+#include "ab_tree.h"
+#include "test.h"
+
+struct big
+{
+	char data[48];
+};
+
+static int copies = 0;
+
+// an element that counts its copies and moves
+struct counted
+{
+	int value;
+
+	explicit counted(int v)
+		: value(v)
+	{}
+	counted(const counted& other)
+		: value(other.value)
+	{
+		++copies;
+	}
+	counted(counted&& other) noexcept
+		: value(other.value)
+	{
+		++copies;
+	}
+	counted& operator=(const counted&) = default;
+};
+
+int main(void)
+{
+	using int_allocator = ab_tree_pool_allocator<int>;
+	using big_allocator = ab_tree_pool_allocator<big>;
+
+	// equality holds before and after the first allocation
+	int_allocator a;
+	int_allocator copy(a);
+	big_allocator rebound(a);
+	REQUIRE(a == copy && a == rebound);
+	REQUIRE(int_allocator(big_allocator(a)) == a);
+	REQUIRE(a != int_allocator());
+	int* p = copy.allocate(1);
+	big* q = rebound.allocate(1);
+	REQUIRE(a == copy && a == rebound);
+	a.deallocate(p, 1);
+	big_allocator(a).deallocate(q, 1);
+
+	// lists whose allocators compare equal may splice nodes between them
+	{
+		std::list<int, int_allocator> l;
+		l.push_back(1);
+		std::list<int, int_allocator> m(l.get_allocator());
+		m.push_back(2);
+		REQUIRE(l.get_allocator() == m.get_allocator());
+		l.splice(l.end(), m);
+		REQUIRE(l.size() == 2 && m.empty() && l.back() == 2);
+	}
+
+	// trees move nodes between each other only if their allocators are equal
+	{
+		ab_tree<int, int_allocator> t;
+		for (int i = 0; i < 1000; ++i)
+			t.push_back(i);
+		ab_tree<int, int_allocator> u = t.split(500);
+		t.concat(std::move(u));
+		REQUIRE(t.size() == 1000 && u.empty());
+		for (int i = 0; i < 1000; ++i)
+			REQUIRE(t[i] == i);
+		t.clear();
+		REQUIRE(t.empty());
+	}
+
+	// trees made from one allocator, or copied, share its pools and move nodes
+	// between each other without touching the elements
+	{
+		using counted_allocator = ab_tree_pool_allocator<counted>;
+		using counted_tree = ab_tree<counted, counted_allocator>;
+		static_assert(std::is_nothrow_move_constructible<counted_tree>::value, "moves allocate nothing");
+		counted_allocator alloc;
+		counted_tree t(alloc), u(alloc);
+		for (int i = 0; i < 1000; ++i)
+		{
+			t.emplace_back(i);
+			u.emplace_back(1000 + i);
+		}
+		counted_tree v(u);
+		REQUIRE(t.get_allocator() == u.get_allocator() && u.get_allocator() == v.get_allocator());
+		copies = 0;
+		t.concat(std::move(u));
+		t.splice(500, std::move(v));
+		counted_tree w(std::move(t));
+		REQUIRE(copies == 0);
+		REQUIRE(w.size() == 3000 && t.empty() && u.empty() && v.empty());
+		for (int i = 0; i < 3000; ++i)
+			REQUIRE(w[i].value == (i < 500 ? i : i < 1500 ? 500 + i : i - 1000));
+	}
+
+	std::puts("ok");
+	return 0;
+}
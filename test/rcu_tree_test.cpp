@@ -0,0 +1,119 @@
+/*====================================================================
+BSD 2-Clause License
+
+Copyright (c) 2023, Ruler
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+====================================================================*/
+
+// Checks that the snapshots of ab_rcu_tree stay consistent while a writer
+// publishes new versions, and that every retired version is reclaimed once
+// no snapshot pins it.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "ab_rcu_tree.h"
+#include "test.h"
+
+using rcu_tree = ab_rcu_tree<int>;
+using tree_type = rcu_tree::tree_type;
+
+// every published version holds consecutive integers
+static void check_version(const tree_type& t)
+{
+	for (size_t i = 0; i + 1 < t.size(); ++i)
+		REQUIRE(t[i] + 1 == t[i + 1]);
+	if (!t.empty())
+		REQUIRE(static_cast<size_t>(t.back() - t.front()) + 1 == t.size());
+}
+
+int main(void)
+{
+	rcu_tree tree;
+
+	// a pinned snapshot keeps its version through later publications
+	{
+		for (int i = 0; i < 100; ++i)
+			tree.writer().push_back(i);
+		tree.publish();
+		rcu_tree::snapshot_type pinned = tree.snapshot();
+		REQUIRE(pinned->size() == 100 && pinned->back() == 99);
+		for (int i = 0; i < 3; ++i)
+		{
+			tree.writer().pop_front();
+			tree.writer().push_back(100 + i);
+			tree.publish();
+		}
+		REQUIRE(tree.reclaim() > 0);
+		check_version(*pinned);
+		REQUIRE(pinned->front() == 0 && pinned->back() == 99);
+	}
+	REQUIRE(tree.reclaim() == 0);
+
+	// readers check the snapshots they pin while the writer publishes
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; ++r)
+	{
+		readers.emplace_back([&]()
+		{
+			int last_front = 0;
+			while (!done.load())
+			{
+				// two snapshots may be pinned at once, the second one newer
+				rcu_tree::snapshot_type a = tree.snapshot();
+				rcu_tree::snapshot_type b = tree.snapshot();
+				check_version(*a);
+				check_version(*b);
+				REQUIRE(a->front() >= last_front && b->front() >= a->front());
+				last_front = b->front();
+			}
+		});
+	}
+	for (int k = 0; k < 2000; ++k)
+	{
+		tree_type& w = tree.writer();
+		// a change undone before publishing is never seen
+		int mid = w[w.size() / 2];
+		w.set(w.size() / 2, -1);
+		w.set(w.size() / 2, mid);
+		w.push_back(w.back() + 1);
+		if (k % 2 == 0)
+			w.pop_front();
+		tree.publish();
+	}
+	done.store(true);
+	for (std::thread& th : readers)
+		th.join();
+
+	REQUIRE(tree.reclaim() == 0);
+	rcu_tree::snapshot_type last = tree.snapshot();
+	check_version(*last);
+	REQUIRE(last->size() == 100 + 1000);
+
+	std::puts("ok");
+	return 0;
+}